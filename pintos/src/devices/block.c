@@ -3,7 +3,11 @@
 #include <string.h>
 #include <stdio.h>
 #include "devices/ide.h"
+#include "devices/timer.h"
+#include "devices/tsc.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/thread.h"
 
 /* A block device. */
 struct block
@@ -29,6 +33,39 @@ static struct block *block_by_role[BLOCK_ROLE_CNT];
 
 static struct block *list_elem_to_block (struct list_elem *);
 
+/* I/O trace.
+
+   When enabled with the kernel command-line option "-iotrace",
+   every sector read or written is recorded in a fixed-size ring
+   buffer, which block_trace_dump() prints to the console.  Once
+   the ring is full, the oldest records are overwritten.
+   utils/block-trace turns a dump into latency histograms and
+   sector heatmaps. */
+
+/* Number of records in the ring.  Must be a power of 2. */
+#define BLOCK_TRACE_SIZE 2048
+
+/* One traced request. */
+struct block_trace_record
+  {
+    uint64_t tsc;                       /* Time-stamp counter at issue. */
+    uint32_t cycles;                    /* Cycles until completion. */
+    int64_t ticks;                      /* Timer ticks at issue. */
+    struct block *block;                /* Device. */
+    block_sector_t sector;              /* First sector. */
+    tid_t tid;                          /* Issuing thread. */
+    uint16_t cnt;                       /* Number of sectors. */
+    uint8_t write;                      /* Write (1) or read (0)? */
+    uint8_t cause;                      /* An enum block_cause. */
+  };
+
+bool block_trace_enabled;
+static struct block_trace_record block_trace[BLOCK_TRACE_SIZE];
+static unsigned block_trace_head;       /* Total records ever taken. */
+
+static void block_trace_record (struct block *, block_sector_t, size_t cnt,
+                                bool write, int64_t ticks, uint64_t start);
+
 /* Returns a human-readable name for the given block device
    TYPE. */
 const char *
@@ -120,9 +157,14 @@ check_sector (struct block *block, block_sector_t sector)
 void
 block_read (struct block *block, block_sector_t sector, void *buffer)
 {
+  int64_t ticks = block_trace_enabled ? timer_ticks () : 0;
+  uint64_t start = rdtsc ();
+
   check_sector (block, sector);
   block->ops->read (block->aux, sector, buffer);
   block->read_cnt++;
+  if (block_trace_enabled)
+    block_trace_record (block, sector, 1, false, ticks, start);
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -133,10 +175,68 @@ block_read (struct block *block, block_sector_t sector, void *buffer)
 void
 block_write (struct block *block, block_sector_t sector, const void *buffer)
 {
+  int64_t ticks = block_trace_enabled ? timer_ticks () : 0;
+  uint64_t start = rdtsc ();
+
   check_sector (block, sector);
   ASSERT (block->type != BLOCK_FOREIGN);
   block->ops->write (block->aux, sector, buffer);
   block->write_cnt++;
+  if (block_trace_enabled)
+    block_trace_record (block, sector, 1, true, ticks, start);
+}
+
+/* Reads CNT consecutive sectors starting at SECTOR from BLOCK
+   into BUFFER, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes.  Drivers that can do so transfer them as a single
+   request, e.g. striped devices spread it over their disks. */
+void
+block_read_multiple (struct block *block, block_sector_t sector, size_t cnt,
+                     void *buffer)
+{
+  int64_t ticks = block_trace_enabled ? timer_ticks () : 0;
+  uint64_t start = rdtsc ();
+  size_t i;
+
+  if (cnt == 0)
+    return;
+  check_sector (block, sector + cnt - 1);
+  if (block->ops->read_multiple != NULL)
+    block->ops->read_multiple (block->aux, sector, cnt, buffer);
+  else
+    for (i = 0; i < cnt; i++)
+      block->ops->read (block->aux, sector + i,
+                        (uint8_t *) buffer + i * BLOCK_SECTOR_SIZE);
+  block->read_cnt += cnt;
+  if (block_trace_enabled)
+    block_trace_record (block, sector, cnt, false, ticks, start);
+}
+
+/* Writes CNT consecutive sectors starting at SECTOR to BLOCK from
+   BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE bytes.
+   Returns after the block device has acknowledged receiving all
+   of the data. */
+void
+block_write_multiple (struct block *block, block_sector_t sector, size_t cnt,
+                      const void *buffer)
+{
+  int64_t ticks = block_trace_enabled ? timer_ticks () : 0;
+  uint64_t start = rdtsc ();
+  size_t i;
+
+  if (cnt == 0)
+    return;
+  check_sector (block, sector + cnt - 1);
+  ASSERT (block->type != BLOCK_FOREIGN);
+  if (block->ops->write_multiple != NULL)
+    block->ops->write_multiple (block->aux, sector, cnt, buffer);
+  else
+    for (i = 0; i < cnt; i++)
+      block->ops->write (block->aux, sector + i,
+                         (const uint8_t *) buffer + i * BLOCK_SECTOR_SIZE);
+  block->write_cnt += cnt;
+  if (block_trace_enabled)
+    block_trace_record (block, sector, cnt, true, ticks, start);
 }
 
 /* Returns the number of sectors in BLOCK. */
@@ -178,6 +278,79 @@ block_print_stats (void)
     }
 }
 
+/* Sets the cause that the current thread's block I/O is charged
+   to in the I/O trace, and returns the previous one, which the
+   caller should restore when done. */
+enum block_cause
+block_set_cause (enum block_cause cause)
+{
+  struct thread *t = thread_current ();
+  enum block_cause old = t->io_cause;
+
+  ASSERT (cause < BLOCK_CAUSE_CNT);
+  t->io_cause = cause;
+  return old;
+}
+
+/* Appends a record for a request for CNT sectors issued at timer
+   tick TICKS and time-stamp counter START that has just
+   completed. */
+static void
+block_trace_record (struct block *block, block_sector_t sector, size_t cnt,
+                    bool write, int64_t ticks, uint64_t start)
+{
+  uint64_t end = rdtsc ();
+  struct block_trace_record *r;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  r = &block_trace[block_trace_head++ % BLOCK_TRACE_SIZE];
+  r->tsc = start;
+  r->cycles = end - start > UINT32_MAX ? UINT32_MAX : end - start;
+  r->ticks = ticks;
+  r->block = block;
+  r->sector = sector;
+  r->tid = thread_current ()->tid;
+  r->cnt = cnt > UINT16_MAX ? UINT16_MAX : cnt;
+  r->write = write;
+  r->cause = thread_current ()->io_cause;
+  intr_set_level (old_level);
+}
+
+/* Prints the I/O trace to the console, oldest record first, and
+   empties it. */
+void
+block_trace_dump (void)
+{
+  static const char *cause_names[BLOCK_CAUSE_CNT] =
+    {
+      "other", "inode", "dir", "data", "free-map", "journal", "swap",
+    };
+  unsigned first, i;
+
+  if (!block_trace_enabled)
+    return;
+
+  /* Stop recording while we print, which does no block I/O
+     but may take a while. */
+  block_trace_enabled = false;
+  first = (block_trace_head > BLOCK_TRACE_SIZE
+           ? block_trace_head - BLOCK_TRACE_SIZE : 0);
+  printf ("block-trace: begin %u records, %u dropped\n",
+          block_trace_head - first, first);
+  for (i = first; i < block_trace_head; i++)
+    {
+      const struct block_trace_record *r = &block_trace[i % BLOCK_TRACE_SIZE];
+      printf ("bt %"PRId64" %"PRIu64" %"PRIu32" %s %c %"PRDSNu" %u %d %s\n",
+              r->ticks, r->tsc, r->cycles, r->block->name,
+              r->write ? 'W' : 'R', r->sector, (unsigned) r->cnt,
+              r->tid, cause_names[r->cause]);
+    }
+  printf ("block-trace: end\n");
+  block_trace_head = 0;
+  block_trace_enabled = true;
+}
+
 int
 block_read_write_counts (struct block *block, long long *read_count, 
                                       long long *write_count) 
@@ -1,6 +1,7 @@
 #ifndef DEVICES_BLOCK_H
 #define DEVICES_BLOCK_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <inttypes.h>
 
@@ -53,12 +54,36 @@ struct block *block_next (struct block *);
 block_sector_t block_size (struct block *);
 void block_read (struct block *, block_sector_t, void *);
 void block_write (struct block *, block_sector_t, const void *);
+void block_read_multiple (struct block *, block_sector_t, size_t cnt,
+                          void *);
+void block_write_multiple (struct block *, block_sector_t, size_t cnt,
+                           const void *);
 const char *block_name (struct block *);
 enum block_type block_type (struct block *);
 
+/* What a block I/O request is for.  Each thread carries one,
+   which is recorded in the I/O trace along with its requests. */
+enum block_cause
+  {
+    BLOCK_CAUSE_OTHER,           /* Not classified. */
+    BLOCK_CAUSE_INODE,           /* Inodes and indirect blocks. */
+    BLOCK_CAUSE_DIR,             /* Directory contents. */
+    BLOCK_CAUSE_DATA,            /* Regular file contents. */
+    BLOCK_CAUSE_FREE_MAP,        /* Free map. */
+    BLOCK_CAUSE_JOURNAL,         /* Metadata journal. */
+    BLOCK_CAUSE_SWAP,            /* Swapped-out pages. */
+    BLOCK_CAUSE_CNT              /* Number of causes. */
+  };
+
+enum block_cause block_set_cause (enum block_cause);
+
 /* Statistics. */
 void block_print_stats (void);
 
+/* I/O trace. */
+extern bool block_trace_enabled;
+void block_trace_dump (void);
+
 int
 block_read_write_counts (struct block *block, long long *read_count, 
                                       long long *write_count);
@@ -69,6 +94,13 @@ struct block_operations
   {
     void (*read) (void *aux, block_sector_t, void *buffer);
     void (*write) (void *aux, block_sector_t, const void *buffer);
+
+    /* Optional: transfer CNT consecutive sectors in one request.
+       If null, the block layer calls read or write CNT times. */
+    void (*read_multiple) (void *aux, block_sector_t, size_t cnt,
+                           void *buffer);
+    void (*write_multiple) (void *aux, block_sector_t, size_t cnt,
+                            const void *buffer);
   };
 
 struct block *block_register (const char *name, enum block_type,
@@ -379,7 +379,9 @@ ide_write (void *d_, block_sector_t sec_no, const void *buffer)
 static struct block_operations ide_operations =
   {
     ide_read,
-    ide_write
+    ide_write,
+    NULL,                       /* No multi-sector transfers. */
+    NULL
   };
 
 /* Selects device D, waiting for it to become ready, and then
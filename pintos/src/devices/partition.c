@@ -1,4 +1,5 @@
 #include "devices/partition.h"
+#include <list.h>
 #include <packed.h>
 #include <stdlib.h>
 #include <string.h>
@@ -11,8 +12,13 @@ struct partition
   {
     struct block *block;                /* Underlying block device. */
     block_sector_t start;               /* First sector within device. */
+    enum block_type type;               /* Type of partition. */
+    struct list_elem elem;              /* Element in all_partitions. */
   };
 
+/* List of all partitions found. */
+static struct list all_partitions = LIST_INITIALIZER (all_partitions);
+
 static struct block_operations partition_operations;
 
 static void read_partition_table (struct block *, block_sector_t sector,
@@ -33,6 +39,37 @@ partition_scan (struct block *block)
     printf ("%s: Device contains no partitions\n", block_name (block));
 }
 
+/* Returns true if partition_scan() found any partitions on
+   BLOCK. */
+bool
+partition_found (struct block *block)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&all_partitions); e != list_end (&all_partitions);
+       e = list_next (e))
+    if (list_entry (e, struct partition, elem)->block == block)
+      return true;
+  return false;
+}
+
+/* Returns true if partition_scan() found a partition of the
+   given TYPE on BLOCK. */
+bool
+partition_found_type (struct block *block, enum block_type type)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&all_partitions); e != list_end (&all_partitions);
+       e = list_next (e))
+    {
+      struct partition *p = list_entry (e, struct partition, elem);
+      if (p->block == block && p->type == type)
+        return true;
+    }
+  return false;
+}
+
 /* Reads the partition table in the given SECTOR of BLOCK and
    scans it for partitions of interest to Pintos.
 
@@ -177,6 +214,8 @@ found_partition (struct block *block, uint8_t part_type,
         PANIC ("Failed to allocate memory for partition descriptor");
       p->block = block;
       p->start = start;
+      p->type = type;
+      list_push_back (&all_partitions, &p->elem);
 
       snprintf (name, sizeof name, "%s%d", block_name (block), part_nr);
       snprintf (extra_info, sizeof extra_info, "%s (%02x)",
@@ -320,5 +359,7 @@ partition_write (void *p_, block_sector_t sector, const void *buffer)
 static struct block_operations partition_operations =
   {
     partition_read,
-    partition_write
+    partition_write,
+    NULL,                       /* No multi-sector transfers. */
+    NULL
   };
@@ -1,8 +1,11 @@
 #ifndef DEVICES_PARTITION_H
 #define DEVICES_PARTITION_H
 
-struct block;
+#include <stdbool.h>
+#include "devices/block.h"
 
 void partition_scan (struct block *);
+bool partition_found (struct block *);
+bool partition_found_type (struct block *, enum block_type);
 
 #endif /* devices/partition.h */
@@ -0,0 +1,230 @@
+#include "devices/stripe.h"
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* A striped ("RAID-0") block device.
+
+   The device's sectors are dealt out to its member devices in
+   chunks of STRIPE_CHUNK sectors, round robin: with two members,
+   chunk 0 lives on member 0, chunk 1 on member 1, chunk 2 on
+   member 0 again, and so on.  A request for many consecutive
+   sectors is split by member, and the pieces are transferred at
+   the same time by one worker thread per member.  With members
+   on separate IDE channels, both channels then work in parallel,
+   each waiting for its own interrupts. */
+
+/* Sectors per chunk.  Pintos does its I/O a sector or a page at a
+   time, so one sector spreads even small transfers. */
+#define STRIPE_CHUNK 1
+
+/* A transfer, split among the members. */
+struct stripe_request
+  {
+    block_sector_t sector;              /* First sector of the stripe. */
+    size_t cnt;                         /* Number of sectors. */
+    uint8_t *buffer;                    /* CNT * BLOCK_SECTOR_SIZE bytes. */
+    bool write;                         /* Write, or read? */
+  };
+
+/* A member device and its worker thread. */
+struct stripe_member
+  {
+    struct stripe *stripe;              /* Owning stripe. */
+    size_t idx;                         /* Index within stripe. */
+    struct block *block;                /* Member device. */
+    struct lock lock;                   /* Held to hand the worker a job. */
+    struct semaphore go;                /* Up'd to start the worker. */
+    struct semaphore done;              /* Up'd by the worker when done. */
+    const struct stripe_request *request;  /* Job for the worker. */
+  };
+
+/* A striped device. */
+struct stripe
+  {
+    size_t member_cnt;                  /* Number of members. */
+    struct stripe_member members[STRIPE_MAX_MEMBERS];
+  };
+
+static struct block_operations stripe_operations;
+static thread_func stripe_worker NO_RETURN;
+
+/* Creates and registers a striped block device named NAME, of
+   TYPE, over the MEMBER_CNT devices in MEMBERS, whose worker
+   threads are started here.  Its size is that of the smallest
+   member times MEMBER_CNT, rounded down to a whole stripe. */
+struct block *
+stripe_create (const char *name, enum block_type type,
+               struct block *members[], size_t member_cnt)
+{
+  struct stripe *s;
+  block_sector_t member_size;
+  char extra_info[64];
+  size_t i;
+
+  ASSERT (member_cnt >= 2 && member_cnt <= STRIPE_MAX_MEMBERS);
+
+  s = malloc (sizeof *s);
+  if (s == NULL)
+    PANIC ("Failed to allocate memory for striped device descriptor");
+
+  s->member_cnt = member_cnt;
+  member_size = block_size (members[0]);
+  for (i = 0; i < member_cnt; i++)
+    {
+      struct stripe_member *m = &s->members[i];
+      char thread_name[16];
+
+      m->stripe = s;
+      m->idx = i;
+      m->block = members[i];
+      lock_init (&m->lock);
+      sema_init (&m->go, 0);
+      sema_init (&m->done, 0);
+      m->request = NULL;
+      if (block_size (m->block) < member_size)
+        member_size = block_size (m->block);
+
+      snprintf (thread_name, sizeof thread_name, "%s-%s",
+                name, block_name (m->block));
+      thread_create (thread_name, PRI_DEFAULT, stripe_worker, m);
+    }
+  member_size -= member_size % STRIPE_CHUNK;
+
+  snprintf (extra_info, sizeof extra_info, "striped over %zu devices",
+            member_cnt);
+  return block_register (name, type, extra_info, member_size * member_cnt,
+                         &stripe_operations, s);
+}
+
+/* Maps SECTOR of stripe S to a member, which is returned, and a
+   sector within it, which is stored in *MEMBER_SECTOR. */
+static struct stripe_member *
+map_sector (struct stripe *s, block_sector_t sector,
+            block_sector_t *member_sector)
+{
+  block_sector_t chunk = sector / STRIPE_CHUNK;
+
+  *member_sector = (chunk / s->member_cnt) * STRIPE_CHUNK
+                   + sector % STRIPE_CHUNK;
+  return &s->members[chunk % s->member_cnt];
+}
+
+/* Transfers the sectors of request R that live on member M. */
+static void
+transfer_member (struct stripe_member *m, const struct stripe_request *r)
+{
+  size_t i;
+
+  for (i = 0; i < r->cnt; i++)
+    {
+      block_sector_t member_sector;
+      uint8_t *buffer = r->buffer + i * BLOCK_SECTOR_SIZE;
+
+      if (map_sector (m->stripe, r->sector + i, &member_sector) != m)
+        continue;
+      if (r->write)
+        block_write (m->block, member_sector, buffer);
+      else
+        block_read (m->block, member_sector, buffer);
+    }
+}
+
+/* Worker thread for member M_: transfers M_'s share of each
+   request it is given. */
+static void
+stripe_worker (void *m_)
+{
+  struct stripe_member *m = m_;
+
+  for (;;)
+    {
+      sema_down (&m->go);
+      transfer_member (m, m->request);
+      sema_up (&m->done);
+    }
+}
+
+/* Carries out request R on stripe S, with every member involved
+   working at the same time. */
+static void
+stripe_transfer (struct stripe *s, const struct stripe_request *r)
+{
+  size_t involved = r->cnt < s->member_cnt * STRIPE_CHUNK
+                    ? DIV_ROUND_UP (r->cnt, STRIPE_CHUNK) : s->member_cnt;
+  size_t first = (r->sector / STRIPE_CHUNK) % s->member_cnt;
+  size_t i;
+
+  /* Members are locked in index order, so that concurrent
+     requests cannot deadlock. */
+  for (i = 0; i < s->member_cnt; i++)
+    if ((i + s->member_cnt - first) % s->member_cnt < involved)
+      {
+        struct stripe_member *m = &s->members[i];
+        lock_acquire (&m->lock);
+        m->request = r;
+        sema_up (&m->go);
+      }
+  for (i = 0; i < s->member_cnt; i++)
+    if ((i + s->member_cnt - first) % s->member_cnt < involved)
+      {
+        struct stripe_member *m = &s->members[i];
+        sema_down (&m->done);
+        m->request = NULL;
+        lock_release (&m->lock);
+      }
+}
+
+/* Reads sector SECTOR from stripe S_ into BUFFER, which must
+   have room for BLOCK_SECTOR_SIZE bytes.  A single sector lives
+   on a single member, so there is nothing to overlap. */
+static void
+stripe_read (void *s_, block_sector_t sector, void *buffer)
+{
+  block_sector_t member_sector;
+  struct stripe_member *m = map_sector (s_, sector, &member_sector);
+  block_read (m->block, member_sector, buffer);
+}
+
+/* Writes sector SECTOR to stripe S_ from BUFFER, which must
+   contain BLOCK_SECTOR_SIZE bytes. */
+static void
+stripe_write (void *s_, block_sector_t sector, const void *buffer)
+{
+  block_sector_t member_sector;
+  struct stripe_member *m = map_sector (s_, sector, &member_sector);
+  block_write (m->block, member_sector, buffer);
+}
+
+/* Reads CNT sectors starting at SECTOR from stripe S_ into
+   BUFFER, from all the members at once. */
+static void
+stripe_read_multiple (void *s_, block_sector_t sector, size_t cnt,
+                      void *buffer)
+{
+  struct stripe_request r = { sector, cnt, buffer, false };
+  stripe_transfer (s_, &r);
+}
+
+/* Writes CNT sectors starting at SECTOR to stripe S_ from
+   BUFFER, to all the members at once. */
+static void
+stripe_write_multiple (void *s_, block_sector_t sector, size_t cnt,
+                       const void *buffer)
+{
+  struct stripe_request r = { sector, cnt, (uint8_t *) buffer, true };
+  stripe_transfer (s_, &r);
+}
+
+static struct block_operations stripe_operations =
+  {
+    stripe_read,
+    stripe_write,
+    stripe_read_multiple,
+    stripe_write_multiple
+  };
@@ -0,0 +1,13 @@
+#ifndef DEVICES_STRIPE_H
+#define DEVICES_STRIPE_H
+
+#include <stddef.h>
+#include "devices/block.h"
+
+/* Most member devices in a striped device. */
+#define STRIPE_MAX_MEMBERS 4
+
+struct block *stripe_create (const char *name, enum block_type,
+                             struct block *members[], size_t member_cnt);
+
+#endif /* devices/stripe.h */
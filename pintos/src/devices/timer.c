@@ -10,21 +10,39 @@
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 
-#if TIMER_FREQ < 19
-#error 8254 timer requires TIMER_FREQ >= 19
-#endif
-#if TIMER_FREQ > 1000
-#error TIMER_FREQ <= 1000 recommended
-#endif
+/* Number of timer interrupts per second. */
+int timer_freq = TIMER_FREQ_DEFAULT;
 
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* Threads blocked in timer_sleep(), in order of wakeup_tick,
+   earliest first.  Only touched with interrupts off. */
+static struct list sleep_list;
+
+/* PIT cycles per timer tick. */
+#define CYCLES_PER_TICK ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Most ticks that one PIT count can cover. */
+#define ONE_SHOT_MAX_TICKS (UINT16_MAX / CYCLES_PER_TICK)
+
+/* Tickless idle.  While only the idle thread can run, the PIT
+   counts down once to the next tick at which something happens
+   instead of interrupting every tick.  ONE_SHOT_TICKS is the
+   number of ticks to credit when that count runs out, or 0 if
+   the PIT is in its usual periodic mode.  ONE_SHOT_COUNT is the
+   count it was loaded with, of which the first ONE_SHOT_FIRST
+   cycles take it to the next tick boundary. */
+static int64_t one_shot_ticks;
+static uint16_t one_shot_count;
+static uint16_t one_shot_first;
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
 static intr_handler_func timer_interrupt;
+static list_less_func wakeup_less;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
@@ -35,7 +53,10 @@ static void real_time_delay (int64_t num, int32_t denom);
 void
 timer_init (void)
 {
+  ASSERT (TIMER_FREQ >= TIMER_FREQ_MIN && TIMER_FREQ <= TIMER_FREQ_MAX);
+
   pit_configure_channel (0, 2, TIMER_FREQ);
+  list_init (&sleep_list);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
 
@@ -85,15 +106,26 @@ timer_elapsed (int64_t then)
 }
 
 /* Sleeps for approximately TICKS timer ticks.  Interrupts must
-   be turned on. */
+   be turned on.
+
+   The thread blocks on sleep_list until the timer interrupt
+   finds its wakeup tick has come, so it is not scheduled at all
+   in the meantime. */
 void
 timer_sleep (int64_t ticks)
 {
-  int64_t start = timer_ticks ();
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
 
   ASSERT (intr_get_level () == INTR_ON);
-  while (timer_elapsed (start) < ticks)
-    thread_yield ();
+  if (ticks <= 0)
+    return;
+
+  old_level = intr_disable ();
+  cur->wakeup_tick = timer_ticks () + ticks;
+  list_insert_ordered (&sleep_list, &cur->elem, wakeup_less, NULL);
+  thread_block ();
+  intr_set_level (old_level);
 }
 
 /* Sleeps for approximately MS milliseconds.  Interrupts must be
@@ -166,14 +198,130 @@ timer_print_stats (void)
   printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
 }
 
-/* Timer interrupt handler. */
+/* Called by the idle thread, with interrupts off, just before
+   it halts.  Unless the next tick that matters is the very next
+   one, switches the PIT to a single countdown that ends at that
+   tick: the earliest wakeup on sleep_list, or under MLFQS the
+   next whole second, when load_avg is due, but no more than
+   ONE_SHOT_MAX_TICKS away.  The countdown ends on a tick
+   boundary, so ticks keep their phase. */
+void
+timer_idle_enter (void)
+{
+  int64_t delta = ONE_SHOT_MAX_TICKS;
+  uint16_t first;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* Still counting down to a tick boundary after an early
+     wakeup. */
+  if (one_shot_ticks != 0)
+    return;
+
+  if (!list_empty (&sleep_list))
+    {
+      struct thread *t = list_entry (list_front (&sleep_list),
+                                     struct thread, elem);
+      if (t->wakeup_tick - ticks < delta)
+        delta = t->wakeup_tick - ticks;
+    }
+  if (thread_mlfqs && TIMER_FREQ - ticks % TIMER_FREQ < delta)
+    delta = TIMER_FREQ - ticks % TIMER_FREQ;
+  if (delta < 2)
+    return;
+
+  first = pit_read_count (0);
+  if (first == 0 || first > CYCLES_PER_TICK)
+    return;
+  one_shot_ticks = delta;
+  one_shot_first = first;
+  one_shot_count = first + (delta - 1) * CYCLES_PER_TICK;
+  pit_configure_one_shot (0, one_shot_count);
+}
+
+/* Called by the scheduler, with interrupts off, whenever the idle
+   thread gives up the CPU.  If the idle thread was woken by some
+   other interrupt before the countdown set by timer_idle_enter()
+   ran out, credits the ticks that passed meanwhile and counts
+   down just to the next tick boundary, whose interrupt puts the
+   PIT back in periodic mode. */
+void
+timer_idle_exit (void)
+{
+  uint16_t left, elapsed, to_boundary;
+  int64_t passed;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (one_shot_ticks <= 1)
+    return;
+
+  /* If the count already ran out, its interrupt is pending and
+     will do the accounting. */
+  left = pit_read_count (0);
+  if (left == 0 || left > one_shot_count)
+    return;
+
+  elapsed = one_shot_count - left;
+  if (elapsed < one_shot_first)
+    {
+      passed = 0;
+      to_boundary = one_shot_first - elapsed;
+    }
+  else
+    {
+      passed = 1 + (elapsed - one_shot_first) / CYCLES_PER_TICK;
+      to_boundary = (CYCLES_PER_TICK
+                     - (elapsed - one_shot_first) % CYCLES_PER_TICK);
+    }
+  ticks += passed;
+  thread_tick_idle (passed);
+
+  one_shot_ticks = 1;
+  one_shot_count = one_shot_first = to_boundary;
+  pit_configure_one_shot (0, one_shot_count);
+}
+
+/* Timer interrupt handler.  Wakes the sleeping threads whose
+   time has come, which are all at the front of sleep_list.  If
+   the PIT was counting down for tickless idle, credits the ticks
+   slept through to the idle thread and restores periodic mode. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED)
 {
-  ticks++;
+  if (one_shot_ticks > 0)
+    {
+      pit_configure_channel (0, 2, TIMER_FREQ);
+      ticks += one_shot_ticks;
+      thread_tick_idle (one_shot_ticks - 1);
+      one_shot_ticks = 0;
+    }
+  else
+    ticks++;
+  while (!list_empty (&sleep_list))
+    {
+      struct thread *t = list_entry (list_front (&sleep_list),
+                                     struct thread, elem);
+      if (t->wakeup_tick > ticks)
+        break;
+      list_pop_front (&sleep_list);
+      thread_unblock (t);
+    }
   thread_tick ();
 }
 
+/* Orders threads on sleep_list by wakeup_tick.  Threads with
+   equal wakeup ticks stay in the order they went to sleep. */
+static bool
+wakeup_less (const struct list_elem *a_, const struct list_elem *b_,
+             void *aux UNUSED)
+{
+  const struct thread *a = list_entry (a_, struct thread, elem);
+  const struct thread *b = list_entry (b_, struct thread, elem);
+
+  return a->wakeup_tick < b->wakeup_tick;
+}
+
 /* Returns true if LOOPS iterations waits for more than one timer
    tick, otherwise false. */
 static bool
@@ -4,8 +4,14 @@
 #include <round.h>
 #include <stdint.h>
 
-/* Number of timer interrupts per second. */
-#define TIMER_FREQ 100
+/* Number of timer interrupts per second, settable with -hz.
+   The 8254 cannot go below 19 Hz, and more than 1000 Hz leaves
+   little time for anything but the timer interrupt. */
+#define TIMER_FREQ timer_freq
+#define TIMER_FREQ_DEFAULT 100
+#define TIMER_FREQ_MIN 19
+#define TIMER_FREQ_MAX 1000
+extern int timer_freq;
 
 void timer_init (void);
 void timer_calibrate (void);
@@ -24,6 +30,10 @@ void timer_mdelay (int64_t milliseconds);
 void timer_udelay (int64_t microseconds);
 void timer_ndelay (int64_t nanoseconds);
 
+/* Tickless idle. */
+void timer_idle_enter (void);
+void timer_idle_exit (void);
+
 void timer_print_stats (void);
 
 #endif /* devices/timer.h */
@@ -1,23 +1,64 @@
 #include "filesys/cache.h"
+#include "threads/malloc.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
 #include <debug.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
 
 
 #define CACHE_BLOCK_COUNT 64
 
+/* Most block devices the cache keeps accounts for. */
+#define CACHE_DEVICE_COUNT 4
+
+/* Pending read-ahead requests; more are dropped. */
+#define READ_AHEAD_QUEUE_SIZE 16
+
+/* Most consecutive queued sectors read with one request. */
+#define READ_AHEAD_BATCH 8
+
+/* Most consecutive dirty sectors written back with one request. */
+#define WRITE_BACK_BATCH 8
+
+/*
+ * a block device using the cache. QUOTA is how many blocks it may keep
+ * once the cache is full: past it, the device has to evict its own
+ * blocks to make room instead of somebody else's.
+ */
+struct cache_device
+  {
+    struct block *block;
+    int quota;
+    int resident;       /* Blocks currently cached, under global_cache_lock. */
+    unsigned write_back_count;  /* Sectors written back, under cache_counter_lock. */
+    long long access_count;
+    long long hit_count;
+  };
+
 struct cache_block
   {
     struct lock l;
+    struct cache_device *device;
     block_sector_t sector_idx;
     bool valid;
     bool dirty;
     bool used;
+    bool pinned;        /* Held by an uncommitted journal transaction. */
+    block_sector_t owner;   /* Inode whose data this is, or CACHE_NO_OWNER. */
+    enum block_cause cause; /* Charged for write-back in the I/O trace. */
     uint8_t data[BLOCK_SECTOR_SIZE];
   };
 
+/* A sector somebody will probably read soon. */
+struct read_ahead_request
+  {
+    struct block *block;
+    block_sector_t sector_idx;
+    enum block_cause cause;     /* The requester's, for the I/O trace. */
+  };
+
 static int clock;
 
 /* cache statistics. */
@@ -29,10 +70,31 @@ static bool initialized = false;
 static struct cache_block cache_blocks[CACHE_BLOCK_COUNT];
 static struct lock global_cache_lock;
 
+/* devices, protected by cache_counter_lock. */
+static struct cache_device cache_devices[CACHE_DEVICE_COUNT];
+
+/* read-ahead queue, protected by read_ahead_lock. */
+static struct read_ahead_request read_ahead_queue[READ_AHEAD_QUEUE_SIZE];
+static int read_ahead_head, read_ahead_cnt;
+static struct lock read_ahead_lock;
+static struct condition read_ahead_cond;
+
+/* where the read-ahead daemon reads a batch before caching it. */
+static uint8_t read_ahead_buffer[READ_AHEAD_BATCH * BLOCK_SECTOR_SIZE];
+
+/* where flush_dirty gathers a run of dirty blocks, under write_back_lock. */
+static uint8_t write_back_buffer[WRITE_BACK_BATCH * BLOCK_SECTOR_SIZE];
+static struct lock write_back_lock;
+
+static thread_func read_ahead_daemon NO_RETURN;
+
 void cache_init (void)
 {
   lock_init (&global_cache_lock);
   lock_init (&cache_counter_lock);
+  lock_init (&read_ahead_lock);
+  cond_init (&read_ahead_cond);
+  lock_init (&write_back_lock);
 
   initialized = true;
   int i;
@@ -40,7 +102,44 @@ void cache_init (void)
     {
       lock_init (&cache_blocks[i].l);
       cache_blocks[i].valid = false;
+      cache_blocks[i].pinned = false;
     }
+
+  thread_create ("readahead", PRI_DEFAULT, read_ahead_daemon, NULL);
+}
+
+/*
+ * returns the accounts of BLOCK, setting them up on first use. the file
+ * system may fill the whole cache; any other device gets a quarter of it
+ * unless cache_set_quota says otherwise
+ */
+static struct cache_device *get_cache_device (struct block *block)
+{
+  struct cache_device *d;
+
+  lock_acquire (&cache_counter_lock);
+  for (d = cache_devices; d < cache_devices + CACHE_DEVICE_COUNT; d++)
+    if (d->block == block || d->block == NULL)
+      break;
+  if (d == cache_devices + CACHE_DEVICE_COUNT)
+    PANIC ("cache: too many block devices");
+  if (d->block == NULL)
+    {
+      d->block = block;
+      d->quota = (block_type (block) == BLOCK_FILESYS
+                  ? CACHE_BLOCK_COUNT : CACHE_BLOCK_COUNT / 4);
+    }
+  lock_release (&cache_counter_lock);
+  return d;
+}
+
+/*
+ * limits BLOCK to QUOTA cache blocks whenever the cache is full
+ */
+void cache_set_quota (struct block *block, int quota)
+{
+  ASSERT (quota > 0 && quota <= CACHE_BLOCK_COUNT);
+  get_cache_device (block)->quota = quota;
 }
 
 int
@@ -53,24 +152,59 @@ cache_get_stats (long long *access_count, long long *hit_count)
   *access_count = cache_access_count;
   *hit_count = cache_hit_count;
   lock_release (&cache_counter_lock);
-  
+
   return 0;
 }
 
-void flush_block (struct block *fs_device, int index)
+/*
+ * prints the accounts of every device that used the cache
+ */
+void cache_print_stats (void)
+{
+  struct cache_device *d;
+  for (d = cache_devices; d < cache_devices + CACHE_DEVICE_COUNT && d->block != NULL; d++)
+    printf ("Cache %s: %lld accesses, %lld hits, %d of %d blocks\n",
+            block_name (d->block), d->access_count, d->hit_count, d->resident, d->quota);
+}
+
+/*
+ * counts CNT sectors of DEVICE about to be written back, so that a batch
+ * read from disk meanwhile knows it may be stale
+ */
+static void count_write_back (struct cache_device *device, size_t cnt)
+{
+  lock_acquire (&cache_counter_lock);
+  device->write_back_count += cnt;
+  lock_release (&cache_counter_lock);
+}
+
+static unsigned get_write_back_count (struct cache_device *device)
 {
-  block_write (fs_device, cache_blocks[index].sector_idx, cache_blocks[index].data);
+  lock_acquire (&cache_counter_lock);
+  unsigned count = device->write_back_count;
+  lock_release (&cache_counter_lock);
+  return count;
+}
+
+void flush_block (int index)
+{
+  count_write_back (cache_blocks[index].device, 1);
+  // charge the write to whoever dirtied the block, not to whoever evicts it
+  enum block_cause old_cause = block_set_cause (cache_blocks[index].cause);
+  block_write (cache_blocks[index].device->block, cache_blocks[index].sector_idx, cache_blocks[index].data);
+  block_set_cause (old_cause);
   cache_blocks[index].dirty = 0;
 }
 
 
-int try_finding_block (struct block *fs_device, block_sector_t sector_idx)
+int try_finding_block (struct block *block, block_sector_t sector_idx)
 {
   int i, found = -1;
   for (i = 0; i < CACHE_BLOCK_COUNT; i++)
     {
       lock_acquire (&cache_blocks[i].l);
-      if (cache_blocks[i].valid && cache_blocks[i].sector_idx == sector_idx)
+      if (cache_blocks[i].valid && cache_blocks[i].sector_idx == sector_idx
+          && cache_blocks[i].device->block == block)
         {
           found = i;
           break;
@@ -83,13 +217,15 @@ int try_finding_block (struct block *fs_device, block_sector_t sector_idx)
 /*
  * returns from this function with the lock of that block in hand
  */
-static int find_an_empty_cache_block (struct block *fs_device, block_sector_t sector_idx)
+static int find_an_empty_cache_block (struct cache_device *device, block_sector_t sector_idx)
 {
   lock_acquire (&global_cache_lock);
   // try once more with global cache lock
-  int index = try_finding_block (fs_device, sector_idx);
+  int index = try_finding_block (device->block, sector_idx);
   if (index != -1)
     return index;
+  // a device over its quota only gets to replace its own blocks
+  bool over_quota = device->resident >= device->quota;
   while (1)
     {
       index = clock;
@@ -98,10 +234,20 @@ static int find_an_empty_cache_block (struct block *fs_device, block_sector_t se
 
       if (!cache_blocks[index].valid)
         {
+          device->resident++;
           lock_release (&global_cache_lock);
           return index;
         }
 
+      /* Pinned blocks must not reach their home location before
+         the journal transaction that modified them commits. */
+      if (cache_blocks[index].pinned
+          || (over_quota && cache_blocks[index].device != device))
+        {
+          lock_release (&cache_blocks[index].l);
+          continue;
+        }
+
       if (!cache_blocks[index].used)
         break;
 
@@ -109,78 +255,412 @@ static int find_an_empty_cache_block (struct block *fs_device, block_sector_t se
       lock_release (&cache_blocks[index].l);
     }
 
+  cache_blocks[index].device->resident--;
+  device->resident++;
+
   // do this before writing to disk to not make others wait
   lock_release (&global_cache_lock);
   if (cache_blocks[index].dirty)
-    flush_block (fs_device, index);
+    flush_block (index);
 
   return index;
 }
 
 /*
- * returns from this function with the lock of that block in hand
+ * returns from this function with the lock of that block in hand.
+ * a new block gets CONTENTS if non-null, was read already, else is
+ * read from disk if READ_FROM_DISK
  */
-static int bring_block_to_cache (struct block *fs_device, block_sector_t sector_idx, bool read_from_disk)
+static int bring_block_to_cache (struct cache_device *device, block_sector_t sector_idx, bool read_from_disk,
+                                 const void *contents)
 {
-  int index = find_an_empty_cache_block (fs_device, sector_idx);
+  int index = find_an_empty_cache_block (device, sector_idx);
+  if (cache_blocks[index].valid && cache_blocks[index].device == device
+      && cache_blocks[index].sector_idx == sector_idx)
+    return index;   // somebody else brought it in meanwhile
+  cache_blocks[index].device = device;
   cache_blocks[index].used = 1;
   cache_blocks[index].valid = 1;
   cache_blocks[index].dirty = 0;
+  cache_blocks[index].pinned = 0;
+  cache_blocks[index].owner = CACHE_NO_OWNER;
+  cache_blocks[index].cause = thread_current ()->io_cause;
   cache_blocks[index].sector_idx = sector_idx;
-  if (read_from_disk)
-    block_read (fs_device, sector_idx, cache_blocks[index].data);
+  if (contents != NULL)
+    memcpy (cache_blocks[index].data, contents, BLOCK_SECTOR_SIZE);
+  else if (read_from_disk)
+    block_read (device->block, sector_idx, cache_blocks[index].data);
   return index;
 }
 
 /*
  * returns from this function with the lock of that block in hand
  */
-int get_block_index (struct block *fs_device, block_sector_t sector_idx, bool read_from_disk)
+int get_block_index (struct block *block, block_sector_t sector_idx, bool read_from_disk)
 {
+  struct cache_device *device = get_cache_device (block);
+  int found = try_finding_block (block, sector_idx);
   lock_acquire (&cache_counter_lock);
   cache_access_count++;
+  device->access_count++;
+  if (found >= 0)
+    {
+      cache_hit_count++;
+      device->hit_count++;
+    }
   lock_release (&cache_counter_lock);
-  int found = try_finding_block (fs_device, sector_idx);
-  if (found >= 0){
-    lock_acquire (&cache_counter_lock);
-    cache_hit_count++;
-    lock_release (&cache_counter_lock);
+  if (found >= 0)
     return found;
-  }
-  return bring_block_to_cache (fs_device, sector_idx, read_from_disk);
+  return bring_block_to_cache (device, sector_idx, read_from_disk, NULL);
 }
 
-void cache_read (struct block *fs_device, block_sector_t sector_idx, void *buffer, off_t size, off_t offset)
+void cache_read (struct block *block, block_sector_t sector_idx, void *buffer, off_t size, off_t offset)
 {
-  int index = get_block_index (fs_device, sector_idx, true);
+  int index = get_block_index (block, sector_idx, true);
   memcpy (buffer, cache_blocks[index].data + offset, size);
   lock_release (&cache_blocks[index].l);
 }
 
+static bool is_cached (struct block *block, block_sector_t sector_idx)
+{
+  int index = try_finding_block (block, sector_idx);
+  if (index < 0)
+    return false;
+  lock_release (&cache_blocks[index].l);
+  return true;
+}
+
+/*
+ * caches the CNT sectors of DEVICE from SECTOR_IDX on, read into BUFFER
+ * with a single request, except those cached meanwhile. once any sector
+ * of the device has been written back, what was read may be older than
+ * what is on disk, so the rest is left to be read again when wanted
+ */
+static void read_run (struct cache_device *device, block_sector_t sector_idx, size_t cnt, uint8_t *buffer)
+{
+  unsigned write_back_count = get_write_back_count (device);
+  size_t i;
+
+  block_read_multiple (device->block, sector_idx, cnt, buffer);
+  for (i = 0; i < cnt; i++)
+    {
+      // a block cached meanwhile may be newer than what was read
+      int index = try_finding_block (device->block, sector_idx + i);
+      if (index < 0)
+        {
+          if (get_write_back_count (device) != write_back_count)
+            break;
+          index = bring_block_to_cache (device, sector_idx + i, false, buffer + i * BLOCK_SECTOR_SIZE);
+        }
+      lock_release (&cache_blocks[index].l);
+    }
+}
+
+/*
+ * brings the CNT sectors listed in SECTORS into the cache before they are
+ * read, reading each run of consecutive ones that is not cached yet with
+ * a single request, so that a striped device serves it from all its
+ * members at once. like read-ahead, not counted as accesses
+ */
+void cache_prefetch (struct block *block, const block_sector_t sectors[], size_t cnt)
+{
+  struct cache_device *device = get_cache_device (block);
+  uint8_t *buffer = NULL;
+  size_t i = 0;
+
+  while (i < cnt)
+    {
+      size_t run = 0;
+      while (i + run < cnt && run < READ_AHEAD_BATCH && sectors[i + run] == sectors[i] + run
+             && !is_cached (block, sectors[i + run]))
+        run++;
+      if (run > 1)
+        {
+          if (buffer == NULL)
+            buffer = malloc (READ_AHEAD_BATCH * BLOCK_SECTOR_SIZE);
+          if (buffer == NULL)
+            return;
+          read_run (device, sectors[i], run, buffer);
+        }
+      i += run > 0 ? run : 1;
+    }
+  free (buffer);
+}
+
+/*
+ * asks for SECTOR_IDX of BLOCK to be brought into the cache in the
+ * background. only a hint: dropped if too many are already pending
+ */
+void cache_read_ahead (struct block *block, block_sector_t sector_idx)
+{
+  if (!initialized || sector_idx >= block_size (block))
+    return;
+  lock_acquire (&read_ahead_lock);
+  if (read_ahead_cnt < READ_AHEAD_QUEUE_SIZE)
+    {
+      struct read_ahead_request *r
+              = &read_ahead_queue[(read_ahead_head + read_ahead_cnt++) % READ_AHEAD_QUEUE_SIZE];
+      r->block = block;
+      r->sector_idx = sector_idx;
+      r->cause = thread_current ()->io_cause;
+      cond_signal (&read_ahead_cond, &read_ahead_lock);
+    }
+  lock_release (&read_ahead_lock);
+}
+
+static void read_ahead_daemon (void *aux UNUSED)
+{
+  for (;;)
+    {
+      lock_acquire (&read_ahead_lock);
+      while (read_ahead_cnt == 0)
+        cond_wait (&read_ahead_cond, &read_ahead_lock);
+      struct read_ahead_request r = read_ahead_queue[read_ahead_head];
+      size_t cnt = 0;
+      // take along the requests for the sectors that follow, so that
+      // a striped device gets to read them from all members at once
+      do
+        {
+          read_ahead_head = (read_ahead_head + 1) % READ_AHEAD_QUEUE_SIZE;
+          read_ahead_cnt--;
+          cnt++;
+        }
+      while (cnt < READ_AHEAD_BATCH && read_ahead_cnt > 0
+             && read_ahead_queue[read_ahead_head].block == r.block
+             && read_ahead_queue[read_ahead_head].sector_idx == r.sector_idx + cnt);
+      lock_release (&read_ahead_lock);
+
+      // not counted as an access: nobody asked for the data yet
+      struct cache_device *device = get_cache_device (r.block);
+      enum block_cause old_cause = block_set_cause (r.cause);
+      if (cnt > 1)
+        read_run (device, r.sector_idx, cnt, read_ahead_buffer);
+      else
+        {
+          int index = try_finding_block (r.block, r.sector_idx);
+          if (index < 0)
+            index = bring_block_to_cache (device, r.sector_idx, true, NULL);
+          lock_release (&cache_blocks[index].l);
+        }
+      block_set_cause (old_cause);
+    }
+}
 
-void cache_write (struct block *fs_device, block_sector_t sector_idx, void *buffer, off_t size, off_t offset)
+
+static void cache_write_do (struct block *block, block_sector_t sector_idx, void *buffer, off_t size,
+                            off_t offset, bool pin, block_sector_t owner)
 {
-  int index = get_block_index (fs_device, sector_idx, offset != 0 || size != BLOCK_SECTOR_SIZE);
+  int index = get_block_index (block, sector_idx, offset != 0 || size != BLOCK_SECTOR_SIZE);
   memcpy (cache_blocks[index].data + offset, buffer, size);
   cache_blocks[index].dirty = 1;
+  cache_blocks[index].cause = thread_current ()->io_cause;
+  if (pin)
+    cache_blocks[index].pinned = 1;
+  if (owner != CACHE_NO_OWNER)
+    cache_blocks[index].owner = owner;
   lock_release (&cache_blocks[index].l);
 }
 
-void cache_done (struct block *fs_device)
+void cache_write (struct block *block, block_sector_t sector_idx, void *buffer, off_t size, off_t offset)
+{
+  cache_write_do (block, sector_idx, buffer, size, offset, false, CACHE_NO_OWNER);
+}
+
+/*
+ * like cache_write, but remembers that the block holds data of the inode
+ * at sector OWNER, so that cache_flush_owner can find it
+ */
+void cache_write_owned (struct block *block, block_sector_t sector_idx, void *buffer, off_t size, off_t offset,
+                        block_sector_t owner)
+{
+  cache_write_do (block, sector_idx, buffer, size, offset, false, owner);
+}
+
+/*
+ * like cache_write, but keeps the block in the cache and away from
+ * its home sector until cache_unpin is called for it
+ */
+void cache_write_pinned (struct block *block, block_sector_t sector_idx, void *buffer, off_t size, off_t offset)
+{
+  cache_write_do (block, sector_idx, buffer, size, offset, true, CACHE_NO_OWNER);
+}
+
+void cache_unpin (struct block *block, block_sector_t sector_idx)
+{
+  int index = try_finding_block (block, sector_idx);
+  if (index < 0)
+    return;
+  cache_blocks[index].pinned = 0;
+  lock_release (&cache_blocks[index].l);
+}
+
+/*
+ * writes the cached copy of SECTOR_IDX to DST_SECTOR on disk, without
+ * touching its dirty state; the block must be pinned
+ */
+void cache_copy_to_disk (struct block *block, block_sector_t sector_idx, block_sector_t dst_sector)
+{
+  int index = try_finding_block (block, sector_idx);
+  ASSERT (index >= 0);
+  ASSERT (cache_blocks[index].pinned);
+  block_write (block, dst_sector, cache_blocks[index].data);
+  lock_release (&cache_blocks[index].l);
+}
+
+/*
+ * true if cache block INDEX, whose lock is held, is a dirty, unpinned
+ * block of BLOCK written for OWNER, or for anybody if ANY_OWNER
+ */
+static bool needs_flush (int index, struct block *block, bool any_owner, block_sector_t owner)
+{
+  struct cache_block *b = &cache_blocks[index];
+  return (b->valid && b->dirty && !b->pinned && b->device->block == block
+          && (any_owner || b->owner == owner));
+}
+
+/*
+ * returns with its lock in hand the cache block holding SECTOR_IDX of
+ * BLOCK if it is dirty and unpinned, else -1. never waits for a lock,
+ * since the caller holds others
+ */
+static int try_locking_dirty (struct block *block, block_sector_t sector_idx)
+{
+  int i;
+  for (i = 0; i < CACHE_BLOCK_COUNT; i++)
+    {
+      if (lock_held_by_current_thread (&cache_blocks[i].l)
+          || !lock_try_acquire (&cache_blocks[i].l))
+        continue;
+      if (needs_flush (i, block, true, 0) && cache_blocks[i].sector_idx == sector_idx)
+        return i;
+      lock_release (&cache_blocks[i].l);
+    }
+  return -1;
+}
+
+/*
+ * writes back the dirty, unpinned blocks of BLOCK written for OWNER, or
+ * all of them if ANY_OWNER, keeping them cached. goes through them in
+ * sector order, taking along the dirty blocks of the sectors that
+ * follow each, whoever they belong to, so that up to WRITE_BACK_BATCH
+ * sectors go out with one request, which a striped device spreads over
+ * all its members
+ */
+static void flush_dirty (struct block *block, bool any_owner, block_sector_t owner)
+{
+  block_sector_t next = 0;
+
+  lock_acquire (&write_back_lock);
+  for (;;)
+    {
+      int run[WRITE_BACK_BATCH];
+      block_sector_t first_sector = 0;
+      int first = -1;
+      size_t cnt, i;
+
+      for (i = 0; i < CACHE_BLOCK_COUNT; i++)
+        {
+          lock_acquire (&cache_blocks[i].l);
+          if (needs_flush (i, block, any_owner, owner) && cache_blocks[i].sector_idx >= next
+              && (first < 0 || cache_blocks[i].sector_idx < first_sector))
+            {
+              first = i;
+              first_sector = cache_blocks[i].sector_idx;
+            }
+          lock_release (&cache_blocks[i].l);
+        }
+      if (first < 0)
+        break;
+
+      lock_acquire (&cache_blocks[first].l);
+      if (!needs_flush (first, block, any_owner, owner) || cache_blocks[first].sector_idx != first_sector)
+        {
+          // changed while unlocked; look again
+          lock_release (&cache_blocks[first].l);
+          continue;
+        }
+      run[0] = first;
+      for (cnt = 1; cnt < WRITE_BACK_BATCH; cnt++)
+        if ((run[cnt] = try_locking_dirty (block, first_sector + cnt)) < 0)
+          break;
+
+      for (i = 0; i < cnt; i++)
+        memcpy (write_back_buffer + i * BLOCK_SECTOR_SIZE, cache_blocks[run[i]].data, BLOCK_SECTOR_SIZE);
+      count_write_back (cache_blocks[first].device, cnt);
+      enum block_cause old_cause = block_set_cause (cache_blocks[first].cause);
+      block_write_multiple (block, first_sector, cnt, write_back_buffer);
+      block_set_cause (old_cause);
+      for (i = 0; i < cnt; i++)
+        {
+          cache_blocks[run[i]].dirty = 0;
+          lock_release (&cache_blocks[run[i]].l);
+        }
+      next = first_sector + cnt;
+    }
+  lock_release (&write_back_lock);
+}
+
+/*
+ * writes every dirty, unpinned block of BLOCK back to disk, keeping it cached
+ */
+void cache_flush (struct block *block)
+{
+  if (!initialized)
+    return;
+  flush_dirty (block, true, CACHE_NO_OWNER);
+}
+
+/*
+ * writes back the dirty blocks written with cache_write_owned for OWNER,
+ * leaving the rest of the cache alone but for dirty blocks right after
+ * them on disk, which go out in the same requests
+ */
+void cache_flush_owner (struct block *block, block_sector_t owner)
+{
+  if (!initialized)
+    return;
+  flush_dirty (block, false, owner);
+}
+
+/*
+ * writes back SECTOR_IDX if it is cached, dirty and not pinned
+ */
+void cache_flush_sector (struct block *block, block_sector_t sector_idx)
+{
+  int index = try_finding_block (block, sector_idx);
+  if (index < 0)
+    return;
+  if (cache_blocks[index].dirty && !cache_blocks[index].pinned)
+    flush_block (index);
+  lock_release (&cache_blocks[index].l);
+}
+
+/*
+ * writes back and drops every block of BLOCK
+ */
+void cache_done (struct block *block)
 {
   if(!initialized)
   {
     return;
   }
+  // write back in batches first; whatever is dirtied meanwhile goes below
+  flush_dirty (block, true, CACHE_NO_OWNER);
   lock_acquire (&global_cache_lock);
   int i;
   for (i = 0; i < CACHE_BLOCK_COUNT; i++)
     {
       lock_acquire (&cache_blocks[i].l);
-      if (cache_blocks[i].valid && cache_blocks[i].dirty)
-        flush_block(fs_device, i);
-      cache_blocks[i].valid = false;
+      /* Blocks of a running journal transaction stay put. */
+      if (cache_blocks[i].valid && cache_blocks[i].device->block == block
+          && !cache_blocks[i].pinned)
+        {
+          if (cache_blocks[i].dirty)
+            flush_block (i);
+          cache_blocks[i].valid = false;
+          cache_blocks[i].device->resident--;
+        }
       lock_release (&cache_blocks[i].l);
     }
   lock_release (&global_cache_lock);
-}
\ No newline at end of file
+}
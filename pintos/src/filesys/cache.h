@@ -4,15 +4,40 @@
 #include "filesys/off_t.h"
 #include "devices/block.h"
 
+/* Owner of cache blocks that do not hold file data. */
+#define CACHE_NO_OWNER ((block_sector_t) -1)
+
 void cache_init (void);
 
 void cache_read (struct block *, block_sector_t, void *, off_t, off_t);
 
+void cache_read_ahead (struct block *, block_sector_t);
+
+void cache_prefetch (struct block *, const block_sector_t[], size_t);
+
 void cache_write (struct block *, block_sector_t, void *, off_t, off_t);
 
+void cache_write_owned (struct block *, block_sector_t, void *, off_t, off_t, block_sector_t owner);
+
+void cache_write_pinned (struct block *, block_sector_t, void *, off_t, off_t);
+
+void cache_unpin (struct block *, block_sector_t);
+
+void cache_copy_to_disk (struct block *, block_sector_t, block_sector_t);
+
+void cache_flush (struct block *);
+
+void cache_flush_owner (struct block *, block_sector_t owner);
+
+void cache_flush_sector (struct block *, block_sector_t);
+
 void cache_done (struct block *);
 
+void cache_set_quota (struct block *, int quota);
+
 int
 cache_get_stats (long long *access_count, long long *hit_count);
 
+void cache_print_stats (void);
+
 #endif
\ No newline at end of file
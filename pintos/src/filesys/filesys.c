@@ -8,6 +8,7 @@
 #include "filesys/inode.h"
 #include "filesys/directory.h"
 #include "filesys/cache.h"
+#include "filesys/journal.h"
 
 #define return_null_on_absolute_wrong_first_char(absolute_path) \
   if(absolute_path==NULL || absolute_path[0]!='/'){             \
@@ -17,6 +18,13 @@
 /* Partition that contains the file system. */
 struct block *fs_device;
 
+/* Most sectors that creating, making or removing one directory
+   entry logs in the journal: the free map sector and inode of a
+   new file or directory, the first sector of a new directory,
+   the entries written in the parent and the child, and a sector
+   of growth of the parent with its index blocks. */
+#define DIR_OP_SECTORS 16
+
 char*
 get_absolute_path(char* file_name)
 {
@@ -39,12 +47,15 @@ filesys_init (bool format)
     PANIC ("No file system device found, can't initialize file system.");
 
   inode_init ();
+  file_init ();
+  dir_init ();
   free_map_init ();
   cache_init ();
 
   if (format)
     do_format ();
 
+  journal_init ();
   free_map_open ();
 }
 
@@ -53,6 +64,7 @@ filesys_init (bool format)
 void
 filesys_done (void)
 {
+  journal_done ();
   cache_done (fs_device);
   free_map_close ();
 }
@@ -70,13 +82,30 @@ filesys_create (const char *full_path, off_t initial_size)
   char* name = get_file_name(full_path);
 
   block_sector_t inode_sector = 0;
+  journal_begin (DIR_OP_SECTORS);
   bool success = (dir != NULL
                   && !dir->inode->removed
                   && free_map_allocate (1, &inode_sector)
-                  && inode_create (inode_sector, initial_size, false)
+                  && inode_create (inode_sector, 0, false)
                   && dir_add (dir, name, inode_sector));
   if (!success && inode_sector != 0)
     free_map_release (inode_sector, 1);
+  journal_end ();
+
+  /* Give the file its initial size afterward, in steps, which
+     need not fit in one transaction with the rest. */
+  if (success && initial_size > 0)
+    {
+      struct inode *inode = inode_open (inode_sector);
+      success = inode != NULL && inode_extend (inode, initial_size);
+      if (!success)
+        {
+          journal_begin (DIR_OP_SECTORS);
+          dir_remove (dir, name);
+          journal_end ();
+        }
+      inode_close (inode);
+    }
   dir_close (dir);
   free (name);
   return success;
@@ -92,6 +121,7 @@ filesys_mkdir (const char *full_path)
   struct dir *child_dir;
 
   block_sector_t inode_sector = 0;
+  journal_begin (DIR_OP_SECTORS);
   bool success = (dir != NULL
                   && free_map_allocate (1, &inode_sector)
                   && dir_create (inode_sector, 1)  // 1 parent with name ".."
@@ -101,6 +131,7 @@ filesys_mkdir (const char *full_path)
 
   if (!success && inode_sector != 0)
     free_map_release (inode_sector, 1);
+  journal_end ();
 
   dir_close (dir);
   free (name);
@@ -186,7 +217,19 @@ filesys_remove (const char *full_path)
 {
   struct dir *dir = file_parent_dir_open_recursive (full_path);
   char* name = get_file_name (full_path);
-  bool success = dir != NULL && name != NULL && dir_remove (dir, name);
+  struct inode *inode = NULL;
+
+  /* Keep the file open until the handle has ended, so that the
+     last close, below, releases its blocks in handles of its own.
+     dir_lookup() does not open "." and it cannot be removed. */
+  if (dir != NULL && name != NULL && dir_lookup (dir, name, &inode)
+      && inode == dir->inode)
+    inode = NULL;
+
+  journal_begin (DIR_OP_SECTORS);
+  bool success = inode != NULL && dir_remove (dir, name);
+  journal_end ();
+  inode_close (inode);
   dir_close (dir);
   free (name);
   return success;
@@ -209,6 +252,7 @@ static void
 do_format (void)
 {
   printf ("Formatting file system...");
+  journal_create ();
   free_map_create ();
   if (!dir_create (ROOT_DIR_SECTOR, 16))
     PANIC ("root directory creation failed");
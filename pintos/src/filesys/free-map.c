@@ -4,6 +4,7 @@
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
@@ -17,6 +18,30 @@ free_map_init (void)
     PANIC ("bitmap creation failed--file system device is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  bitmap_set_multiple (free_map, JOURNAL_SECTOR, 1 + JOURNAL_LOG_SECTORS, true);
+}
+
+/* Returns the first of CNT free consecutive sectors at or after
+   START that the journal could not overwrite on replay, and that
+   were not freed by a transaction that has yet to commit, or
+   BITMAP_ERROR if there are none. */
+static size_t
+free_map_scan (size_t start, size_t cnt)
+{
+  for (;;)
+    {
+      size_t sector = bitmap_scan (free_map, start, cnt, false);
+      size_t i;
+
+      if (sector == BITMAP_ERROR)
+        return BITMAP_ERROR;
+      for (i = 0; i < cnt; i++)
+        if (journal_is_logged (sector + i) || journal_is_freed (sector + i))
+          break;
+      if (i == cnt)
+        return sector;
+      start = sector + i + 1;
+    }
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
@@ -27,10 +52,12 @@ free_map_init (void)
 bool
 free_map_allocate (size_t cnt, block_sector_t *sectorp)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
+  block_sector_t sector = free_map_scan (0, cnt);
+  if (sector != BITMAP_ERROR)
+    bitmap_set_multiple (free_map, sector, cnt, true);
   if (sector != BITMAP_ERROR
       && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+      && !bitmap_write_range (free_map, free_map_file, sector, cnt))
     {
       bitmap_set_multiple (free_map, sector, cnt, false);
       sector = BITMAP_ERROR;
@@ -40,13 +67,17 @@ free_map_allocate (size_t cnt, block_sector_t *sectorp)
   return sector != BITMAP_ERROR;
 }
 
-/* Makes CNT sectors starting at SECTOR available for use. */
+/* Makes CNT sectors starting at SECTOR available for use, once
+   the running journal transaction, which records them as free,
+   has committed.  Until then, a crash could bring back the
+   metadata that still points to them. */
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
   ASSERT (bitmap_all (free_map, sector, cnt));
   bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  journal_free (sector, cnt);
+  bitmap_write_range (free_map, free_map_file, sector, cnt);
 }
 
 /* Opens the free map file and reads it from disk. */
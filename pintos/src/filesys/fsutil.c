@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ustar.h>
+#include "filesys/cache.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
@@ -67,6 +68,28 @@ fsutil_rm (char **argv)
     PANIC ("%s: delete failed\n", file_name);
 }
 
+/* Number of sectors fsutil_extract() reads ahead of itself. */
+#define EXTRACT_READ_AHEAD 8
+
+/* Reads SECTOR from the scratch device SRC into BUFFER through
+   the cache.  On reaching each window of EXTRACT_READ_AHEAD
+   sectors, asks for the whole next window to be read in the
+   background meanwhile, so that the cache can read it with a
+   single request. */
+static void
+read_scratch (struct block *src, block_sector_t sector, void *buffer)
+{
+  block_sector_t ahead;
+
+  if (sector == 0)
+    for (ahead = 1; ahead < EXTRACT_READ_AHEAD; ahead++)
+      cache_read_ahead (src, ahead);
+  if (sector % EXTRACT_READ_AHEAD == 0)
+    for (ahead = 0; ahead < EXTRACT_READ_AHEAD; ahead++)
+      cache_read_ahead (src, sector + EXTRACT_READ_AHEAD + ahead);
+  cache_read (src, sector, buffer, BLOCK_SECTOR_SIZE, 0);
+}
+
 /* Extracts a ustar-format tar archive from the scratch block
    device into the Pintos file system. */
 void
@@ -99,7 +122,7 @@ fsutil_extract (char **argv UNUSED)
       int size;
 
       /* Read and parse ustar header. */
-      block_read (src, sector++, header);
+      read_scratch (src, sector++, header);
       error = ustar_parse_header (header, &file_name, &type, &size);
       
       if (error != NULL)
@@ -129,7 +152,7 @@ fsutil_extract (char **argv UNUSED)
               int chunk_size = (size > BLOCK_SECTOR_SIZE
                                 ? BLOCK_SECTOR_SIZE
                                 : size);
-              block_read (src, sector++, data);
+              read_scratch (src, sector++, data);
               if (file_write (dst, data, chunk_size) != chunk_size)
                 PANIC ("%s: write failed with %d bytes unwritten",
                        file_name, size);
@@ -147,8 +170,11 @@ fsutil_extract (char **argv UNUSED)
      end-of-archive marker. */
   printf ("Erasing ustar archive...\n");
   memset (header, 0, BLOCK_SECTOR_SIZE);
-  block_write (src, 0, header);
-  block_write (src, 1, header);
+  cache_write (src, 0, header, BLOCK_SECTOR_SIZE, 0);
+  cache_write (src, 1, header, BLOCK_SECTOR_SIZE, 0);
+
+  /* Write that back and give the cache to the file system. */
+  cache_done (src);
 
   free (data);
   free (header);
@@ -6,11 +6,17 @@
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/thread.h"
 #include "cache.h"
+#include "journal.h"
 
 
 struct lock open_inodes_lock;
 
+/* Cache for struct inode. */
+static struct kmem_cache *inode_cache;
+
 
 /* Returns the number of sectors to allocate for an inode SIZE
    bytes long. */
@@ -43,12 +49,27 @@ byte_to_sector (const struct inode *inode, off_t pos)
    returns the same `struct inode'. */
 static struct list open_inodes;
 
+/* Returns the cause that block I/O for INODE's contents is
+   charged to in the I/O trace.  Index blocks read on the way to
+   the contents are charged to the same cause. */
+static enum block_cause
+inode_data_cause (const struct inode *inode)
+{
+  if (inode->data.is_dir)
+    return BLOCK_CAUSE_DIR;
+  else if (inode->sector == FREE_MAP_SECTOR)
+    return BLOCK_CAUSE_FREE_MAP;
+  else
+    return BLOCK_CAUSE_DATA;
+}
+
 /* Initializes the inode module. */
 void
 inode_init (void)
 {
   lock_init (&open_inodes_lock);
   list_init (&open_inodes);
+  inode_cache = kmem_cache_create ("inode", sizeof (struct inode), NULL);
 }
 
 static bool inode_allocate_sector (block_sector_t *sector)
@@ -107,7 +128,7 @@ bool inode_try_creating_indirect (block_sector_t *sector, size_t sectors, bool c
       free_map_release (*sector, 1);
       return false;
     }
-  cache_write (fs_device, *sector, indirect, BLOCK_SECTOR_SIZE, 0);
+  journal_write (*sector, indirect, BLOCK_SECTOR_SIZE, 0);
   free (indirect);
   return 1;
 }
@@ -150,7 +171,7 @@ bool inode_try_creating_double_indirect (block_sector_t *sector, size_t sectors)
       return 0;
     }
   else
-    cache_write (fs_device, *sector, double_indirect, BLOCK_SECTOR_SIZE, 0);
+    journal_write (*sector, double_indirect, BLOCK_SECTOR_SIZE, 0);
   free (double_indirect);
   return 1;
 }
@@ -170,7 +191,7 @@ bool inode_try_growing_indirect (block_sector_t sector, size_t sectors, size_t c
       free (node);
       return false;
     }
-  cache_write (fs_device, sector, node, BLOCK_SECTOR_SIZE, 0);
+  journal_write (sector, node, BLOCK_SECTOR_SIZE, 0);
   free (node);
   return true;
 }
@@ -313,6 +334,7 @@ inode_create (block_sector_t sector, off_t length, bool is_dir)
   disk_inode = calloc (1, sizeof *disk_inode);
   if (disk_inode != NULL)
     {
+      enum block_cause old_cause = block_set_cause (BLOCK_CAUSE_INODE);
       size_t sectors = bytes_to_sectors (length);
       disk_inode->length = length;
       disk_inode->magic = INODE_MAGIC;
@@ -320,8 +342,9 @@ inode_create (block_sector_t sector, off_t length, bool is_dir)
       if (success)
         {
           disk_inode->is_dir = is_dir;
-          cache_write (fs_device, sector, disk_inode, BLOCK_SECTOR_SIZE, 0);
+          journal_write (sector, disk_inode, BLOCK_SECTOR_SIZE, 0);
         }
+      block_set_cause (old_cause);
       free (disk_inode);
     }
 
@@ -353,7 +376,7 @@ inode_open (block_sector_t sector)
     }
 
   /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  inode = kmem_cache_alloc (inode_cache);
   if (inode == NULL)
     {
       lock_release (&open_inodes_lock);
@@ -367,7 +390,10 @@ inode_open (block_sector_t sector)
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
+  inode->meta_dirty = false;
+  enum block_cause old_cause = block_set_cause (BLOCK_CAUSE_INODE);
   cache_read (fs_device, inode->sector, &inode->data, BLOCK_SECTOR_SIZE, 0);
+  block_set_cause (old_cause);
   lock_release (&open_inodes_lock);
   return inode;
 }
@@ -388,9 +414,84 @@ inode_get_inumber (const struct inode *inode)
   return inode->sector;
 }
 
-/* Closes INODE and writes it to disk.
+/* Most sectors of a removed inode released in one journal
+   handle.  Each release logs at most one free map sector, so
+   the blocks of a file of any size are released in handles
+   that fit in a transaction. */
+#define INODE_RELEASE_STEP 8
+
+/* Releases SECTOR, one of the blocks of an inode being
+   deallocated, and counts it in *RELEASED.  Ends the current
+   handle and starts another every INODE_RELEASE_STEP sectors. */
+static void
+inode_release_step (block_sector_t sector, size_t *released)
+{
+  free_map_release (sector, 1);
+  if (++*released % INODE_RELEASE_STEP == 0)
+    {
+      journal_end ();
+      journal_begin (INODE_RELEASE_STEP);
+    }
+}
+
+/* Releases the data and index blocks of DATA, a removed inode,
+   over as many journal handles as it takes.  The current thread
+   must be inside a handle of its own, not nested in another. */
+static void
+inode_deallocate (struct inode_disk *data)
+{
+  size_t sectors = bytes_to_sectors (data->length);
+  size_t released = 0;
+  size_t i, j, cnt;
+  struct indirect_node *node = malloc (sizeof *node);
+  struct indirect_node *inner = malloc (sizeof *inner);
+
+  ASSERT (thread_current ()->journal_depth <= 1);
+
+  /* Without memory to read the index blocks, leak the blocks
+     rather than free ones still in use. */
+  if (node == NULL || inner == NULL)
+    goto done;
+
+  cnt = min (sectors, INODE_INSTANT_CHILDREN_COUNT);
+  for (i = 0; i < cnt; i++)
+    inode_release_step (data->children[i], &released);
+  sectors -= cnt;
+
+  if (sectors > 0)
+    {
+      cnt = min (sectors, INODE_INDIRECT_INSTANT_CHILDREN_COUNT);
+      cache_read (fs_device, data->indirect, node, BLOCK_SECTOR_SIZE, 0);
+      for (i = 0; i < cnt; i++)
+        inode_release_step (node->children[i], &released);
+      inode_release_step (data->indirect, &released);
+      sectors -= cnt;
+    }
+
+  if (sectors > 0)
+    {
+      cache_read (fs_device, data->double_indirect, node, BLOCK_SECTOR_SIZE, 0);
+      for (i = 0; sectors > 0; i++)
+        {
+          cnt = min (sectors, INODE_INDIRECT_INSTANT_CHILDREN_COUNT);
+          cache_read (fs_device, node->children[i], inner, BLOCK_SECTOR_SIZE, 0);
+          for (j = 0; j < cnt; j++)
+            inode_release_step (inner->children[j], &released);
+          inode_release_step (node->children[i], &released);
+          sectors -= cnt;
+        }
+      inode_release_step (data->double_indirect, &released);
+    }
+
+ done:
+  free (inner);
+  free (node);
+}
+
+/* Closes INODE.
    If this was the last reference to INODE, frees its memory.
-   If INODE was also a removed inode, frees its blocks. */
+   If INODE was also a removed inode, frees its blocks, which
+   must not happen inside a journal handle. */
 void
 inode_close (struct inode *inode)
 {
@@ -406,45 +507,18 @@ inode_close (struct inode *inode)
       list_remove (&inode->elem);
       lock_release (&open_inodes_lock);
 
-      /* Deallocate blocks if removed. */
+      /* Deallocate blocks if removed.  Otherwise there is nothing
+         to write: every change to the inode was journaled as it
+         was made. */
       if (inode->removed)
         {
-          size_t sectors = bytes_to_sectors (inode->data.length);
-
-          size_t instant_sectors = min (sectors, INODE_INSTANT_CHILDREN_COUNT);
-          inode_release_sectors (inode->data.children, instant_sectors);
-          sectors -= instant_sectors;
-
-          size_t indirect_sectors = min (sectors, INODE_INDIRECT_INSTANT_CHILDREN_COUNT);
-          if (indirect_sectors)
-            {
-              inode_release_indirect (inode->data.indirect, indirect_sectors);
-              free_map_release (inode->data.indirect, 1);
-            }
-          sectors -= indirect_sectors;
-
-          size_t i, indirect_nodes = DIV_ROUND_UP (sectors, INODE_INDIRECT_INSTANT_CHILDREN_COUNT);
-          if (indirect_nodes)
-            {
-              struct indirect_node *double_indirect_node = calloc (1, sizeof (struct indirect_node));
-              cache_read (fs_device, inode->data.double_indirect, double_indirect_node, BLOCK_SECTOR_SIZE, 0);
-              for (i = 0; i < indirect_nodes; i++)
-                {
-                  size_t to_release_sectors;
-                  if (i + 1 < indirect_nodes || sectors % INODE_INDIRECT_INSTANT_CHILDREN_COUNT == 0)
-                    to_release_sectors = INODE_INDIRECT_INSTANT_CHILDREN_COUNT;
-                  else
-                    to_release_sectors = sectors % INODE_INDIRECT_INSTANT_CHILDREN_COUNT;
-                  inode_release_indirect (double_indirect_node->children[i], to_release_sectors);
-                }
-              free_map_release (inode->data.double_indirect, 1);
-              free (double_indirect_node);
-            }
+          enum block_cause old_cause = block_set_cause (BLOCK_CAUSE_INODE);
+          journal_begin (INODE_RELEASE_STEP);
+          inode_deallocate (&inode->data);
+          journal_end ();
+          block_set_cause (old_cause);
         }
-      else
-        cache_write (fs_device, inode->sector, &inode->data, BLOCK_SECTOR_SIZE, 0);
-
-      free (inode);
+      kmem_cache_free (inode_cache, inode);
     }
 }
 
@@ -457,6 +531,21 @@ inode_remove (struct inode *inode)
   inode->removed = true;
 }
 
+/* Most data sectors brought into the cache together by a read
+   that spans several, so that a big read does not evict its own
+   sectors before it gets to them. */
+#define PREFETCH_SECTORS 8
+
+/* Brings the first of the CNT data sectors listed in SECTORS, up
+   to PREFETCH_SECTORS of them, into the cache, so that those that
+   are consecutive on disk are read with one request. */
+static void
+prefetch_sectors (block_sector_t sectors[], size_t cnt)
+{
+  if (cnt > 1)
+    cache_prefetch (fs_device, sectors, min (cnt, PREFETCH_SECTORS));
+}
+
 off_t inode_read_at_indirect (block_sector_t children[], uint8_t *buffer, off_t size, off_t offset)
 {
   off_t bytes_read = 0;
@@ -465,12 +554,17 @@ off_t inode_read_at_indirect (block_sector_t children[], uint8_t *buffer, off_t
   off_t first_node_index = offset / node_size;
   block_sector_t first_node = children[first_node_index];
   off_t from_first_size = min (size, node_size - (offset % node_size));
+
+  size_t sector_cnt = DIV_ROUND_UP (offset % node_size + size, node_size);
+  prefetch_sectors (children + first_node_index, sector_cnt);
   cache_read (fs_device, first_node, buffer, from_first_size, offset % BLOCK_SECTOR_SIZE);
   bytes_read += from_first_size;
 
   size_t i;
   for (i = first_node_index + 1; bytes_read < size; i++)
     {
+      if ((i - first_node_index) % PREFETCH_SECTORS == 0)
+        prefetch_sectors (children + i, sector_cnt - (i - first_node_index));
       cache_read (fs_device, children[i], buffer + bytes_read, min (size - bytes_read, node_size), 0);
       bytes_read += min (size - bytes_read, node_size);
     }
@@ -560,13 +654,37 @@ off_t
 inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 {
   inode_acquire_lock (inode);
+  enum block_cause old_cause = block_set_cause (inode_data_cause (inode));
   off_t result = inode_read_at_do (inode, buffer_, size, offset);
+  block_set_cause (old_cause);
   inode_release_lock (inode);
   return result;
 }
 
 
-off_t inode_write_at_indirect (block_sector_t children[], uint8_t *buffer, off_t size, off_t offset)
+/* Directory and free map contents are metadata: their writes go
+   through the journal.  Ordinary file data does not. */
+static bool
+inode_is_metadata (const struct inode *inode)
+{
+  return inode->data.is_dir || inode->sector == FREE_MAP_SECTOR;
+}
+
+/* Writes one data sector.  OWNER is the sector of the inode
+   the data belongs to, so that inode_sync() can find it later,
+   or CACHE_NO_OWNER for metadata, which goes through the
+   journal instead. */
+static void
+inode_write_sector (block_sector_t sector, void *buffer, off_t size, off_t offset, block_sector_t owner)
+{
+  if (owner == CACHE_NO_OWNER)
+    journal_write (sector, buffer, size, offset);
+  else
+    cache_write_owned (fs_device, sector, buffer, size, offset, owner);
+}
+
+off_t inode_write_at_indirect (block_sector_t children[], uint8_t *buffer, off_t size, off_t offset,
+                               block_sector_t owner)
 {
   off_t bytes_written = 0;
   off_t node_size = BLOCK_SECTOR_SIZE;
@@ -574,19 +692,21 @@ off_t inode_write_at_indirect (block_sector_t children[], uint8_t *buffer, off_t
   off_t first_node_index = offset / node_size;
   block_sector_t first_node = children[first_node_index];
   off_t from_first_size = min (size, node_size - (offset % node_size));
-  cache_write (fs_device, first_node, buffer, from_first_size, offset % BLOCK_SECTOR_SIZE);
+  inode_write_sector (first_node, buffer, from_first_size, offset % BLOCK_SECTOR_SIZE, owner);
   bytes_written += from_first_size;
 
   size_t i;
   for (i = first_node_index + 1; bytes_written < size; i++)
     {
-      cache_write (fs_device, children[i], buffer + bytes_written, min (size - bytes_written, node_size), 0);
+      inode_write_sector (children[i], buffer + bytes_written, min (size - bytes_written, node_size), 0,
+                          owner);
       bytes_written += min (size - bytes_written, node_size);
     }
   return bytes_written;
 }
 
-off_t inode_write_at_double_indirect (struct indirect_node *node, uint8_t *buffer, off_t size, off_t offset)
+off_t inode_write_at_double_indirect (struct indirect_node *node, uint8_t *buffer, off_t size, off_t offset,
+                                      block_sector_t owner)
 {
   off_t bytes_written = 0;
   off_t node_size = BLOCK_SECTOR_SIZE * INODE_INDIRECT_INSTANT_CHILDREN_COUNT;
@@ -598,13 +718,15 @@ off_t inode_write_at_double_indirect (struct indirect_node *node, uint8_t *buffe
   if (!indirect)
     return 0;
   cache_read (fs_device, first_node, indirect, BLOCK_SECTOR_SIZE, 0);
-  bytes_written += inode_write_at_indirect (indirect->children, buffer, from_first_size, offset % node_size);
+  bytes_written += inode_write_at_indirect (indirect->children, buffer, from_first_size, offset % node_size,
+                                            owner);
 
   size_t i;
   for (i = first_node_index + 1; bytes_written < size; i++)
     {
       cache_read (fs_device, node->children[i], indirect, BLOCK_SECTOR_SIZE, 0);
-      inode_write_at_indirect (indirect->children, buffer + bytes_written, min (size - bytes_written, node_size), 0);
+      inode_write_at_indirect (indirect->children, buffer + bytes_written, min (size - bytes_written, node_size), 0,
+                               owner);
       bytes_written += min (size - bytes_written, node_size);
     }
 
@@ -623,14 +745,8 @@ inode_write_at_do (struct inode *inode, const void *buffer_, off_t size,
 {
   uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
+  block_sector_t owner = inode_is_metadata (inode) ? CACHE_NO_OWNER : inode->sector;
 
-  if (offset + size > inode->data.length)
-    {
-      if (!inode_grow (&inode->data, bytes_to_sectors (offset + size)))
-        return 0;
-      inode->data.length = offset + size;
-      cache_write (fs_device, inode->sector, &inode->data, BLOCK_SECTOR_SIZE, 0);
-    }
   size = min (size, inode->data.length - offset);
   if (size <= 0)
     return 0;
@@ -642,7 +758,7 @@ inode_write_at_do (struct inode *inode, const void *buffer_, off_t size,
   if (to_read_from_children > 0)
     {
       bytes_written += inode_write_at_indirect (inode->data.children, buffer + bytes_written, to_read_from_children,
-                                                offset);
+                                                offset, owner);
       offset = 0;
     }
   else
@@ -660,7 +776,8 @@ inode_write_at_do (struct inode *inode, const void *buffer_, off_t size,
   if (to_read_from_indirect > 0)
     {
       cache_read (fs_device, inode->data.indirect, node, BLOCK_SECTOR_SIZE, 0);
-      bytes_written += inode_write_at_indirect (node->children, buffer + bytes_written, to_read_from_indirect, offset);
+      bytes_written += inode_write_at_indirect (node->children, buffer + bytes_written, to_read_from_indirect, offset,
+                                                owner);
       offset = 0;
     }
   else
@@ -672,23 +789,121 @@ inode_write_at_do (struct inode *inode, const void *buffer_, off_t size,
       cache_read (fs_device, inode->data.double_indirect, node, BLOCK_SECTOR_SIZE, 0);
       bytes_written += inode_write_at_double_indirect (node, buffer + bytes_written,
                                                        to_read_from_double_indirect,
-                                                       offset);
+                                                       offset, owner);
     }
 
   free (node);
   return bytes_written;
 }
 
+/* Most sectors a file grows by in one journal handle. */
+#define INODE_GROW_STEP 8
+
+/* Most sectors a step of growth logs: a free map sector for each
+   new data sector and each of up to two new index blocks, two
+   indirect blocks, the doubly indirect block, and the inode. */
+#define INODE_GROW_SECTORS (INODE_GROW_STEP + 2 + 2 + 1 + 1)
+
+/* Grows INODE, whose lock must be held, toward LENGTH bytes, by
+   at most INODE_GROW_STEP sectors.  Returns false if it could
+   not grow. */
+static bool
+inode_grow_step (struct inode *inode, off_t length)
+{
+  size_t sectors = bytes_to_sectors (inode->data.length) + INODE_GROW_STEP;
+  enum block_cause old_cause = block_set_cause (BLOCK_CAUSE_INODE);
+  bool grown;
+
+  if (length > (off_t) (sectors * BLOCK_SECTOR_SIZE))
+    length = sectors * BLOCK_SECTOR_SIZE;
+  grown = inode_grow (&inode->data, bytes_to_sectors (length));
+  if (grown)
+    {
+      inode->data.length = length;
+      inode->meta_dirty = true;
+      journal_write (inode->sector, &inode->data, BLOCK_SECTOR_SIZE, 0);
+    }
+  block_set_cause (old_cause);
+  return grown;
+}
+
+/* Grows INODE to at least LENGTH bytes, a step per journal
+   handle, so that the metadata of a big extension does not have
+   to fit in a single transaction.  Inside an enclosing handle
+   the steps all go into its transaction, but such extensions are
+   of directories, by a sector at most.  Returns false if INODE
+   could not grow that much.  A file that is already long enough
+   takes no handle at all. */
+bool
+inode_extend (struct inode *inode, off_t length)
+{
+  bool success = true;
+
+  while (success && length > inode_length (inode))
+    {
+      /* The handle must be taken before the inode lock: starting
+         one may wait for a commit, which waits for other
+         handles. */
+      journal_begin (INODE_GROW_SECTORS);
+      inode_acquire_lock (inode);
+      if (length > inode->data.length && !inode_grow_step (inode, length))
+        success = false;
+      inode_release_lock (inode);
+      journal_end ();
+    }
+  return success;
+}
+
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
                 off_t offset)
 {
+  bool metadata = inode_is_metadata (inode);
+
+  /* If the file cannot grow all the way, write what fits. */
+  inode_extend (inode, offset + size);
+
+  /* Only metadata goes through the journal, a sector at a time.
+     The handle must be taken before the inode lock: starting one
+     may wait for a commit, which waits for other handles. */
+  if (metadata)
+    journal_begin (bytes_to_sectors (size) + 1);
   inode_acquire_lock (inode);
+  enum block_cause old_cause = block_set_cause (inode_data_cause (inode));
   off_t result = inode_write_at_do (inode, buffer_, size, offset);
+  block_set_cause (old_cause);
   inode_release_lock (inode);
+  if (metadata)
+    journal_end ();
   return result;
 }
 
+/* Writes INODE's dirty data blocks back to disk, without
+   disturbing the rest of the cache.  Unless DATA_ONLY, also makes
+   its metadata (inode and indirect blocks) durable.  With
+   DATA_ONLY the metadata is still synced if the inode grew since
+   the last sync, because the new data could not be found without
+   it. */
+void
+inode_sync (struct inode *inode, bool data_only)
+{
+  bool sync_meta;
+
+  ASSERT (inode != NULL);
+
+  inode_acquire_lock (inode);
+  cache_flush_owner (fs_device, inode->sector);
+  sync_meta = !data_only || inode->meta_dirty || inode_is_metadata (inode);
+  inode->meta_dirty = false;
+  inode_release_lock (inode);
+
+  if (sync_meta)
+    {
+      journal_commit ();
+      cache_flush_sector (fs_device, inode->sector);
+    }
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 void
@@ -0,0 +1,498 @@
+#include "filesys/journal.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/cache.h"
+#include "filesys/filesys.h"
+#include "devices/timer.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Metadata write-ahead journal.
+
+   Every operation that changes file system metadata (inodes,
+   indirect blocks, directory contents and the free map) runs
+   between journal_begin() and journal_end().  Inside such a
+   handle, metadata sectors are written with journal_write(),
+   which records the sector in the running transaction and pins
+   its cache block so that it cannot reach its home location
+   early.
+
+   Whoever starts a handle says how many sectors it may log at
+   most, and the transaction keeps that much room for it until
+   the handle ends; operations that could need a lot, such as
+   growing or deleting a big file, are split over several
+   handles.  Only metadata updates take handles: writing file
+   data logs nothing and does not wait for the journal.  Handles
+   of concurrent threads all join the same running transaction,
+   as long as it has room for what they reserve; a thread that
+   would not fit commits the transaction first.  A running
+   transaction is committed as a whole, in one sequential
+   burst of writes to the log, when it grows large, when the
+   journal daemon wakes up, or when someone asks for it with
+   journal_commit().  A transaction in the log looks like this:
+
+        +------------+--------+- - - -+--------+--------+
+        | descriptor | copy 0 |  ...  | copy N | commit |
+        +------------+--------+- - - -+--------+--------+
+
+   After the commit record is on disk the cache blocks are
+   unpinned and written home lazily, and the sectors the
+   transaction freed may be allocated again.  When the log is nearly full
+   we flush the cache and start over at the beginning of the log
+   (a "checkpoint").  At mount, journal_init() replays every
+   complete transaction found in the log. */
+
+/* Magic numbers for the on-disk structures. */
+#define JOURNAL_MAGIC 0x4a524e4c        /* Journal header. */
+#define DESC_MAGIC 0x4a445343           /* Transaction descriptor. */
+#define COMMIT_MAGIC 0x4a434d54         /* Commit record. */
+
+/* Most sectors a transaction may pin in the cache.  Must leave
+   plenty of the cache free for everybody else. */
+#define JOURNAL_TXN_MAX 48
+
+/* How often the journal daemon commits, in timer ticks. */
+#define JOURNAL_COMMIT_INTERVAL (5 * TIMER_FREQ)
+
+/* First sector of the log. */
+#define LOG_START (JOURNAL_SECTOR + 1)
+
+/* On-disk journal header.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct journal_header
+  {
+    unsigned magic;                     /* JOURNAL_MAGIC. */
+    uint32_t seq;                       /* Sequence number of first txn in log. */
+    uint8_t unused[504];                /* Not used. */
+  };
+
+/* On-disk transaction descriptor, followed in the log by a copy
+   of each of the CNT sectors it names.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct journal_desc
+  {
+    unsigned magic;                     /* DESC_MAGIC. */
+    uint32_t seq;                       /* Transaction sequence number. */
+    uint32_t cnt;                       /* Number of logged sectors. */
+    block_sector_t sectors[125];        /* Home location of each copy. */
+  };
+
+/* On-disk commit record.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct journal_commit
+  {
+    unsigned magic;                     /* COMMIT_MAGIC. */
+    uint32_t seq;                       /* Same as the descriptor's. */
+    uint8_t unused[504];                /* Not used. */
+  };
+
+/* The running transaction. */
+struct transaction
+  {
+    uint32_t seq;                       /* Sequence number. */
+    int handle_cnt;                     /* Threads inside a handle. */
+    size_t sector_cnt;                  /* Number of sectors logged. */
+    size_t reserved;                    /* Sectors kept for open handles. */
+    block_sector_t sectors[JOURNAL_TXN_MAX];
+  };
+
+static bool active;                     /* Journal found and replayed? */
+static struct lock journal_lock;        /* Protects everything below. */
+static struct condition journal_cond;   /* Signaled on handle end and commit. */
+static bool committing;                 /* Commit in progress? */
+static struct transaction running;      /* The running transaction. */
+static size_t log_head;                 /* Next free log sector, from LOG_START. */
+static struct bitmap *logged;           /* Sectors with a copy in the log. */
+static struct bitmap *freed;            /* Sectors freed by the running txn. */
+
+static thread_func journal_daemon NO_RETURN;
+static void commit_locked (void);
+static void checkpoint_locked (void);
+static void write_header (uint32_t seq);
+static void replay (void);
+
+/* Writes an empty journal to the file system device.  Called by
+   do_format().  The device may hold the log of an earlier file
+   system, whose first transaction has the same sequence number
+   as ours will, so we also wipe the first descriptor: otherwise
+   replay() could copy that old metadata over the new file
+   system. */
+void
+journal_create (void)
+{
+  void *zeros;
+  enum block_cause old_cause;
+
+  ASSERT (sizeof (struct journal_header) == BLOCK_SECTOR_SIZE);
+
+  zeros = calloc (1, BLOCK_SECTOR_SIZE);
+  if (zeros == NULL)
+    PANIC ("journal: out of memory");
+  old_cause = block_set_cause (BLOCK_CAUSE_JOURNAL);
+  block_write (fs_device, LOG_START, zeros);
+  block_set_cause (old_cause);
+  free (zeros);
+
+  write_header (0);
+}
+
+/* Replays the transactions committed to the journal, if there is
+   one, and starts journaling.  Must be called before anything is
+   read through the cache. */
+void
+journal_init (void)
+{
+  ASSERT (sizeof (struct journal_desc) == BLOCK_SECTOR_SIZE);
+  ASSERT (sizeof (struct journal_commit) == BLOCK_SECTOR_SIZE);
+
+  lock_init (&journal_lock);
+  cond_init (&journal_cond);
+
+  logged = bitmap_create (block_size (fs_device));
+  freed = bitmap_create (block_size (fs_device));
+  if (logged == NULL || freed == NULL)
+    PANIC ("bitmap creation failed--file system device is too large");
+
+  replay ();
+  if (active)
+    thread_create ("journald", PRI_DEFAULT, journal_daemon, NULL);
+}
+
+/* Commits the running transaction and checkpoints the log, so
+   that the journal is empty when the file system is shut down. */
+void
+journal_done (void)
+{
+  if (!active)
+    return;
+  ASSERT (thread_current ()->journal_depth == 0);
+
+  lock_acquire (&journal_lock);
+  commit_locked ();
+  checkpoint_locked ();
+  lock_release (&journal_lock);
+}
+
+/* Starts a handle on the running transaction for the current
+   thread, which may log up to SECTORS sectors in it.  Handles
+   nest; only the outermost one counts, so its SECTORS must cover
+   whatever the nested ones log as well.  Must not be called
+   while holding any other file system lock, because it may have
+   to wait for a commit to finish. */
+void
+journal_begin (size_t sectors)
+{
+  struct thread *t = thread_current ();
+
+  if (!active || t->journal_depth++ > 0)
+    return;
+  ASSERT (sectors <= JOURNAL_TXN_MAX);
+
+  lock_acquire (&journal_lock);
+  for (;;)
+    {
+      while (committing)
+        cond_wait (&journal_cond, &journal_lock);
+      if (running.sector_cnt + running.reserved + sectors <= JOURNAL_TXN_MAX)
+        break;
+      if (running.sector_cnt > 0)
+        commit_locked ();
+      else
+        cond_wait (&journal_cond, &journal_lock);
+    }
+  running.handle_cnt++;
+  running.reserved += sectors;
+  t->journal_credits = sectors;
+  lock_release (&journal_lock);
+}
+
+/* Ends the current thread's handle.  Does not commit: that is
+   left for later, so that many operations share one commit. */
+void
+journal_end (void)
+{
+  struct thread *t = thread_current ();
+
+  if (!active)
+    return;
+  ASSERT (t->journal_depth > 0);
+  if (--t->journal_depth > 0)
+    return;
+
+  lock_acquire (&journal_lock);
+  running.handle_cnt--;
+  running.reserved -= t->journal_credits;
+  t->journal_credits = 0;
+  cond_broadcast (&journal_cond, &journal_lock);
+  lock_release (&journal_lock);
+}
+
+/* Writes SIZE bytes from BUFFER to metadata SECTOR at OFFSET,
+   through the cache, as part of the running transaction.
+   Outside a handle this is a plain cache_write().  Panics if the
+   transaction is full, which can only happen if some handle logs
+   more sectors than it said it would. */
+void
+journal_write (block_sector_t sector, void *buffer, off_t size, off_t offset)
+{
+  struct thread *t = thread_current ();
+
+  if (!active || t->journal_depth == 0)
+    {
+      cache_write (fs_device, sector, buffer, size, offset);
+      return;
+    }
+
+  lock_acquire (&journal_lock);
+  size_t i;
+  for (i = 0; i < running.sector_cnt; i++)
+    if (running.sectors[i] == sector)
+      break;
+  if (i == running.sector_cnt)
+    {
+      if (t->journal_credits > 0)
+        {
+          t->journal_credits--;
+          running.reserved--;
+        }
+      else if (running.sector_cnt + running.reserved >= JOURNAL_TXN_MAX)
+        PANIC ("journal: transaction overflow writing sector %"PRDSNu,
+               sector);
+      running.sectors[running.sector_cnt++] = sector;
+    }
+  lock_release (&journal_lock);
+
+  cache_write_pinned (fs_device, sector, buffer, size, offset);
+}
+
+/* Records that the CNT sectors starting at SECTOR were freed in
+   the running transaction, so that they are not reused before it
+   commits.  Outside a handle the sectors are free right away. */
+void
+journal_free (block_sector_t sector, size_t cnt)
+{
+  if (!active || thread_current ()->journal_depth == 0)
+    return;
+
+  lock_acquire (&journal_lock);
+  bitmap_set_multiple (freed, sector, cnt, true);
+  lock_release (&journal_lock);
+}
+
+/* Makes every metadata update so far durable, by committing the
+   running transaction now.  Without a journal, writes back the
+   whole cache instead.  The current thread must not be inside a
+   handle. */
+void
+journal_commit (void)
+{
+  if (!active)
+    {
+      cache_flush (fs_device);
+      return;
+    }
+  ASSERT (thread_current ()->journal_depth == 0);
+
+  lock_acquire (&journal_lock);
+  while (committing)
+    cond_wait (&journal_cond, &journal_lock);
+  commit_locked ();
+  lock_release (&journal_lock);
+}
+
+/* Returns true if SECTOR has a copy in the live part of the log.
+   Such a sector must not be reused for file data before the next
+   checkpoint, or replay could overwrite the data with stale
+   metadata. */
+bool
+journal_is_logged (block_sector_t sector)
+{
+  return active && bitmap_test (logged, sector);
+}
+
+/* Returns true if SECTOR was freed by the running transaction,
+   which has not committed yet. */
+bool
+journal_is_freed (block_sector_t sector)
+{
+  return active && bitmap_test (freed, sector);
+}
+
+/* Commits the running transaction every
+   JOURNAL_COMMIT_INTERVAL ticks. */
+static void
+journal_daemon (void *aux UNUSED)
+{
+  for (;;)
+    {
+      timer_sleep (JOURNAL_COMMIT_INTERVAL);
+      journal_commit ();
+    }
+}
+
+/* Writes the running transaction to the log.  Waits for every
+   open handle on it to end first; new handles wait until we are
+   done.  JOURNAL_LOCK must be held. */
+static void
+commit_locked (void)
+{
+  struct journal_desc *desc;
+  enum block_cause old_cause;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&journal_lock));
+
+  if (running.sector_cnt == 0)
+    {
+      /* Nothing was logged, so nothing freed can come back. */
+      bitmap_set_all (freed, false);
+      return;
+    }
+
+  committing = true;
+  while (running.handle_cnt > 0)
+    cond_wait (&journal_cond, &journal_lock);
+  old_cause = block_set_cause (BLOCK_CAUSE_JOURNAL);
+
+  desc = calloc (1, sizeof *desc);
+  if (desc == NULL)
+    PANIC ("journal: out of memory");
+  desc->magic = DESC_MAGIC;
+  desc->seq = running.seq;
+  desc->cnt = running.sector_cnt;
+  memcpy (desc->sectors, running.sectors,
+          running.sector_cnt * sizeof *running.sectors);
+
+  /* Descriptor, copies, then commit record, all in one
+     sequential run of the log. */
+  ASSERT (log_head + running.sector_cnt + 2 <= JOURNAL_LOG_SECTORS);
+  block_write (fs_device, LOG_START + log_head, desc);
+  for (i = 0; i < running.sector_cnt; i++)
+    cache_copy_to_disk (fs_device, running.sectors[i],
+                        LOG_START + log_head + 1 + i);
+  memset (desc, 0, sizeof *desc);
+  ((struct journal_commit *) desc)->magic = COMMIT_MAGIC;
+  ((struct journal_commit *) desc)->seq = running.seq;
+  block_write (fs_device, LOG_START + log_head + 1 + running.sector_cnt,
+               desc);
+  free (desc);
+  block_set_cause (old_cause);
+
+  /* The transaction is durable; let its blocks go home and the
+     sectors it freed be used again. */
+  for (i = 0; i < running.sector_cnt; i++)
+    {
+      bitmap_mark (logged, running.sectors[i]);
+      cache_unpin (fs_device, running.sectors[i]);
+    }
+  bitmap_set_all (freed, false);
+  log_head += running.sector_cnt + 2;
+  running.sector_cnt = 0;
+  running.seq++;
+
+  /* Make sure the next transaction fits. */
+  if (log_head + JOURNAL_TXN_MAX + 2 > JOURNAL_LOG_SECTORS)
+    checkpoint_locked ();
+
+  committing = false;
+  cond_broadcast (&journal_cond, &journal_lock);
+}
+
+/* Writes every committed block to its home location and empties
+   the log.  Must be called with no pinned blocks in the cache,
+   i.e. between a commit and the next handle.  JOURNAL_LOCK must
+   be held. */
+static void
+checkpoint_locked (void)
+{
+  ASSERT (lock_held_by_current_thread (&journal_lock));
+  ASSERT (running.sector_cnt == 0);
+
+  cache_flush (fs_device);
+  write_header (running.seq);
+  log_head = 0;
+  bitmap_set_all (logged, false);
+}
+
+/* Writes a journal header saying the log is empty and the next
+   transaction has sequence number SEQ. */
+static void
+write_header (uint32_t seq)
+{
+  struct journal_header *h = calloc (1, sizeof *h);
+  enum block_cause old_cause;
+
+  if (h == NULL)
+    PANIC ("journal: out of memory");
+  h->magic = JOURNAL_MAGIC;
+  h->seq = seq;
+  old_cause = block_set_cause (BLOCK_CAUSE_JOURNAL);
+  block_write (fs_device, JOURNAL_SECTOR, h);
+  block_set_cause (old_cause);
+  free (h);
+}
+
+/* Reads the journal header and copies every complete transaction
+   in the log to its home location, then empties the log.  Sets
+   ACTIVE if the device has a journal at all. */
+static void
+replay (void)
+{
+  struct journal_header *h = malloc (BLOCK_SECTOR_SIZE);
+  struct journal_desc *desc = malloc (BLOCK_SECTOR_SIZE);
+  struct journal_commit *commit = malloc (BLOCK_SECTOR_SIZE);
+  void *buffer = malloc (BLOCK_SECTOR_SIZE);
+  size_t pos = 0, replayed = 0;
+  enum block_cause old_cause;
+  uint32_t seq;
+
+  if (h == NULL || desc == NULL || commit == NULL || buffer == NULL)
+    PANIC ("journal: out of memory");
+  old_cause = block_set_cause (BLOCK_CAUSE_JOURNAL);
+
+  block_read (fs_device, JOURNAL_SECTOR, h);
+  if (h->magic != JOURNAL_MAGIC)
+    {
+      printf ("journal: none found, metadata updates are not journaled\n");
+      goto done;
+    }
+
+  for (seq = h->seq; pos + 2 <= JOURNAL_LOG_SECTORS; seq++)
+    {
+      size_t i;
+
+      block_read (fs_device, LOG_START + pos, desc);
+      if (desc->magic != DESC_MAGIC || desc->seq != seq
+          || desc->cnt == 0 || desc->cnt > JOURNAL_TXN_MAX
+          || pos + desc->cnt + 2 > JOURNAL_LOG_SECTORS)
+        break;
+      block_read (fs_device, LOG_START + pos + 1 + desc->cnt, commit);
+      if (commit->magic != COMMIT_MAGIC || commit->seq != seq)
+        break;
+
+      for (i = 0; i < desc->cnt; i++)
+        {
+          block_read (fs_device, LOG_START + pos + 1 + i, buffer);
+          block_write (fs_device, desc->sectors[i], buffer);
+        }
+      pos += desc->cnt + 2;
+      replayed++;
+    }
+  if (replayed > 0)
+    printf ("journal: replayed %zu transaction(s)\n", replayed);
+
+  write_header (seq);
+  running.seq = seq;
+  log_head = 0;
+  active = true;
+
+ done:
+  block_set_cause (old_cause);
+  free (buffer);
+  free (commit);
+  free (desc);
+  free (h);
+}
@@ -0,0 +1,27 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <stdbool.h>
+#include "devices/block.h"
+#include "filesys/off_t.h"
+
+/* On-disk journal region, reserved by do_format() right after
+   the free map and root directory inodes. */
+#define JOURNAL_SECTOR 2                /* Journal header sector. */
+#define JOURNAL_LOG_SECTORS 128         /* Size of the log that follows it. */
+
+void journal_create (void);
+void journal_init (void);
+void journal_done (void);
+
+void journal_begin (size_t sectors);
+void journal_end (void);
+void journal_write (block_sector_t, void *, off_t size, off_t offset);
+void journal_commit (void);
+
+void journal_free (block_sector_t, size_t cnt);
+
+bool journal_is_logged (block_sector_t);
+bool journal_is_freed (block_sector_t);
+
+#endif /* filesys/journal.h */
@@ -358,6 +358,27 @@ bitmap_write (const struct bitmap *b, struct file *file)
   off_t size = byte_cnt (b->bit_cnt);
   return file_write_at (file, b->bits, size, 0) == size;
 }
+
+/* Writes just the bytes of B that hold the CNT bits starting at
+   START to FILE, where bitmap_write() would put them.  (On the
+   little-endian 80x86, bit K of an element is in byte K / 8 of
+   it.)  Return true if successful, false otherwise. */
+bool
+bitmap_write_range (const struct bitmap *b, struct file *file,
+                    size_t start, size_t cnt)
+{
+  off_t ofs, size;
+
+  ASSERT (b != NULL);
+  ASSERT (start <= b->bit_cnt);
+  ASSERT (start + cnt <= b->bit_cnt);
+
+  if (cnt == 0)
+    return true;
+  ofs = start / CHAR_BIT;
+  size = (start + cnt - 1) / CHAR_BIT + 1 - ofs;
+  return file_write_at (file, (const char *) b->bits + ofs, size, ofs) == size;
+}
 #endif /* FILESYS */
 
 /* Debugging. */
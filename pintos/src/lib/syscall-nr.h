@@ -32,7 +32,14 @@ enum
     SYS_INUMBER,                /* Returns the inode number for a fd. */
     SYS_CACHEINV,               /* Invalidates the cache. */
     SYS_CACHESTAT,              /* Returns the cache hit/miss count. */
-    SYS_DISKREADWRITECOUNT      /* Returns the disk read/write count. */      
+    SYS_DISKREADWRITECOUNT,     /* Returns the disk read/write count. */
+    SYS_FSYNC,                  /* Writes a file's data and metadata to disk. */
+    SYS_FDATASYNC,              /* Writes a file's data to disk. */
+    SYS_BLOCKTRACE,             /* Dumps the block I/O trace. */
+    SYS_SETSHARES,              /* Sets the stride scheduler CPU share. */
+    SYS_EDF,                    /* Reserves CPU as a periodic EDF thread. */
+    SYS_EDFSTAT,                /* Returns EDF deadline miss counts. */
+    SYS_SBRK                    /* Moves the end of the heap. */
   };
 
 #endif /* lib/syscall-nr.h */
@@ -1,25 +1,418 @@
 #include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
 
-void*
-malloc (size_t size)
+/* A user heap allocator on top of sbrk().
+
+   The heap is a sequence of blocks, each with a one-word header
+   and a one-word footer ("boundary tags") that hold the block's
+   size and whether it is allocated.  The footer lets free() find
+   the previous block in constant time, so a freed block is
+   merged with free neighbors on both sides at once.
+
+   Free blocks are kept on segregated lists, one per power-of-two
+   size class.  malloc() takes the first block that fits from the
+   smallest class that can hold the request, splitting off any
+   remainder big enough to be a block of its own.  If none fits,
+   the heap is grown with sbrk() by just as much as is needed,
+   less any free block at its end.  realloc() grows or shrinks a
+   block in place when its neighbors allow.
+
+   The heap begins with an allocated "prologue" block and ends
+   with an allocated, zero-size "epilogue" header, so that merging
+   needs no special cases at either end. */
+
+/* Alignment of every block and of every pointer returned. */
+#define ALIGNMENT 8
+
+/* Size of a header or footer. */
+#define TAG_SIZE sizeof (size_t)
+
+/* Bit set in a tag when the block is allocated. */
+#define ALLOCATED 1
+
+/* Smallest block: tags plus room for the free list links. */
+#define MIN_BLOCK 16
+
+/* Size classes: class 0 holds blocks of 16 to 31 bytes, class 1
+   32 to 63 bytes, and so on; the last holds everything bigger. */
+#define CLASS_CNT 24
+
+/* Value sbrk() returns on failure. */
+#define SBRK_FAILED ((void *) -1)
+
+/* Links in the payload of a free block. */
+struct free_block
+  {
+    struct free_block *prev;
+    struct free_block *next;
+  };
+
+/* Free lists, by size class. */
+static struct free_block *free_lists[CLASS_CNT];
+
+/* Has the heap been set up? */
+static bool heap_ready;
+
+/* Returns the header of block BP, given its payload. */
+static size_t *
+header (void *bp)
 {
-  /* Homework 5, Part B: YOUR CODE HERE */
-  return NULL;
+  return (size_t *) bp - 1;
 }
 
-void free (void* ptr)
+/* Returns the size of block BP, tags included. */
+static size_t
+block_size (void *bp)
 {
-  /* Homework 5, Part B: YOUR CODE HERE */
+  return *header (bp) & ~(size_t) (ALIGNMENT - 1);
 }
 
-void* calloc (size_t nmemb, size_t size)
+/* Returns true if block BP is allocated. */
+static bool
+is_allocated (void *bp)
 {
-  /* Homework 5, Part B: YOUR CODE HERE */
-  return NULL;
+  return (*header (bp) & ALLOCATED) != 0;
 }
 
-void* realloc (void* ptr, size_t size)
+/* Returns the block after BP. */
+static void *
+next_block (void *bp)
 {
-  /* Homework 5, Part B: YOUR CODE HERE */
+  return (uint8_t *) bp + block_size (bp);
+}
+
+/* Returns the block before BP, found through its footer. */
+static void *
+prev_block (void *bp)
+{
+  size_t *prev_footer = (size_t *) bp - 2;
+  return (uint8_t *) bp - (*prev_footer & ~(size_t) (ALIGNMENT - 1));
+}
+
+/* Sets the header and footer of block BP. */
+static void
+set_tags (void *bp, size_t size, bool allocated)
+{
+  size_t tag = size | (allocated ? ALLOCATED : 0);
+  *header (bp) = tag;
+  *(size_t *) ((uint8_t *) bp + size - 2 * TAG_SIZE) = tag;
+}
+
+/* Makes BP, which must be just past the last block, the
+   epilogue. */
+static void
+set_epilogue (void *bp)
+{
+  *header (bp) = 0 | ALLOCATED;
+}
+
+/* Returns the size class for a block of SIZE bytes. */
+static int
+size_class (size_t size)
+{
+  int class = 0;
+
+  for (size >>= 5; size > 0 && class < CLASS_CNT - 1; size >>= 1)
+    class++;
+  return class;
+}
+
+/* Puts free block BP on the front of its free list. */
+static void
+insert_free (void *bp)
+{
+  struct free_block *b = bp;
+  struct free_block **list = &free_lists[size_class (block_size (bp))];
+
+  b->prev = NULL;
+  b->next = *list;
+  if (*list != NULL)
+    (*list)->prev = b;
+  *list = b;
+}
+
+/* Takes free block BP off its free list. */
+static void
+remove_free (void *bp)
+{
+  struct free_block *b = bp;
+
+  if (b->prev != NULL)
+    b->prev->next = b->next;
+  else
+    free_lists[size_class (block_size (bp))] = b->next;
+  if (b->next != NULL)
+    b->next->prev = b->prev;
+}
+
+/* Merges free block BP, which is on no list, with its free
+   neighbors, puts the result on its free list, and returns it. */
+static void *
+coalesce (void *bp)
+{
+  size_t size = block_size (bp);
+  void *next = next_block (bp);
+
+  if (!is_allocated (next))
+    {
+      remove_free (next);
+      size += block_size (next);
+    }
+  if (!is_allocated (prev_block (bp)))
+    {
+      bp = prev_block (bp);
+      remove_free (bp);
+      size += block_size (bp);
+    }
+  set_tags (bp, size, false);
+  insert_free (bp);
+  return bp;
+}
+
+/* Sets up an empty heap.  Returns false if sbrk() fails. */
+static bool
+init_heap (void)
+{
+  uint8_t *start = sbrk (0);
+  size_t pad = (ALIGNMENT - ((uintptr_t) start + 3 * TAG_SIZE) % ALIGNMENT)
+               % ALIGNMENT;
+  uint8_t *prologue;
+
+  /* Padding, prologue header and footer, epilogue header.  The
+     padding aligns the first block, which will start just past
+     the epilogue header. */
+  if (sbrk (pad + 3 * TAG_SIZE) == SBRK_FAILED)
+    return false;
+  prologue = start + pad + TAG_SIZE;
+  set_tags (prologue, 2 * TAG_SIZE, true);
+  set_epilogue (next_block (prologue));
+  heap_ready = true;
+  return true;
+}
+
+/* Returns the free block at the end of the heap, or a null
+   pointer if the last block is allocated.  BRK is the break. */
+static void *
+last_free_block (uint8_t *brk)
+{
+  void *epilogue = brk;
+  void *last = prev_block (epilogue);
+  return is_allocated (last) ? NULL : last;
+}
+
+/* Grows the heap so that it ends with a free block of at least
+   SIZE bytes, and returns that block, off its free list.
+   Returns a null pointer if sbrk() fails. */
+static void *
+extend_heap (size_t size)
+{
+  uint8_t *brk = sbrk (0);
+  void *last = last_free_block (brk);
+  size_t have = last != NULL ? block_size (last) : 0;
+  void *bp;
+
+  if (sbrk (size - have) == SBRK_FAILED)
+    return NULL;
+
+  /* The old epilogue becomes the new block's header. */
+  bp = brk;
+  set_tags (bp, size - have, false);
+  set_epilogue (next_block (bp));
+  if (last != NULL)
+    {
+      remove_free (last);
+      set_tags (last, size, false);
+      bp = last;
+    }
+  return bp;
+}
+
+/* Makes free block BP, which is on no list, an allocated block of
+   SIZE bytes, putting any remainder big enough for a block of
+   its own back on the free lists. */
+static void
+place (void *bp, size_t size)
+{
+  size_t have = block_size (bp);
+
+  if (have - size >= MIN_BLOCK)
+    {
+      set_tags (bp, size, true);
+      set_tags (next_block (bp), have - size, false);
+      coalesce (next_block (bp));
+    }
+  else
+    set_tags (bp, have, true);
+}
+
+/* Returns the first free block of at least SIZE bytes, off its
+   free list, or a null pointer if there is none. */
+static void *
+find_fit (size_t size)
+{
+  int class;
+
+  for (class = size_class (size); class < CLASS_CNT; class++)
+    {
+      struct free_block *b;
+
+      for (b = free_lists[class]; b != NULL; b = b->next)
+        if (block_size (b) >= size)
+          {
+            remove_free (b);
+            return b;
+          }
+    }
   return NULL;
 }
+
+/* Returns the block size needed for a SIZE-byte request, or 0 if
+   SIZE is too big.  The heap is grown by at most a block at a
+   time, and sbrk() takes a signed increment, so no block may be
+   bigger than PTRDIFF_MAX. */
+static size_t
+adjust_size (size_t size)
+{
+  if (size > PTRDIFF_MAX - 2 * TAG_SIZE - ALIGNMENT)
+    return 0;
+  size = (size + 2 * TAG_SIZE + ALIGNMENT - 1) & ~(size_t) (ALIGNMENT - 1);
+  return size < MIN_BLOCK ? MIN_BLOCK : size;
+}
+
+/* Obtains and returns a new block of at least SIZE bytes.
+   Returns a null pointer if SIZE is zero or memory is not
+   available. */
+void *
+malloc (size_t size)
+{
+  size_t asize = adjust_size (size);
+  void *bp;
+
+  if (size == 0 || asize == 0)
+    return NULL;
+  if (!heap_ready && !init_heap ())
+    return NULL;
+
+  bp = find_fit (asize);
+  if (bp == NULL)
+    {
+      bp = extend_heap (asize);
+      if (bp == NULL)
+        return NULL;
+    }
+  place (bp, asize);
+  return bp;
+}
+
+/* Frees block P, which must have been previously allocated with
+   malloc(), calloc(), or realloc(). */
+void
+free (void *p)
+{
+  if (p == NULL)
+    return;
+  set_tags (p, block_size (p), false);
+  coalesce (p);
+}
+
+/* Allocates and return A times B bytes initialized to zeroes.
+   Returns a null pointer if memory is not available. */
+void *
+calloc (size_t a, size_t b)
+{
+  void *p;
+
+  if (b != 0 && a > SIZE_MAX / b)
+    return NULL;
+  p = malloc (a * b);
+  if (p != NULL)
+    memset (p, 0, a * b);
+  return p;
+}
+
+/* Tries to make allocated block BP at least SIZE bytes long where
+   it is, by taking in a free block after it and, if BP is at the
+   end of the heap, growing the heap.  Returns true if
+   successful. */
+static bool
+grow_in_place (void *bp, size_t size)
+{
+  size_t have = block_size (bp);
+  void *next = next_block (bp);
+
+  if (!is_allocated (next))
+    {
+      have += block_size (next);
+      if (have < size && block_size (next_block (next)) == 0)
+        {
+          /* BP and the free block after it end the heap. */
+          if (sbrk (size - have) == SBRK_FAILED)
+            return false;
+          set_epilogue ((uint8_t *) next_block (next) + (size - have));
+          have = size;
+        }
+      if (have < size)
+        return false;
+      remove_free (next);
+    }
+  else if (block_size (next) == 0)
+    {
+      /* BP ends the heap. */
+      if (sbrk (size - have) == SBRK_FAILED)
+        return false;
+      set_epilogue ((uint8_t *) next + (size - have));
+      have = size;
+    }
+  else
+    return false;
+
+  set_tags (bp, have, true);
+  return true;
+}
+
+/* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly moving
+   it in the process.  If successful, returns the new block; on
+   failure, returns a null pointer and leaves OLD_BLOCK as it
+   was.  A call with null OLD_BLOCK is equivalent to malloc(); a
+   call with zero NEW_SIZE is equivalent to free(). */
+void *
+realloc (void *old_block, size_t new_size)
+{
+  size_t asize = adjust_size (new_size);
+  size_t have;
+  void *new_block;
+
+  if (old_block == NULL)
+    return malloc (new_size);
+  if (new_size == 0)
+    {
+      free (old_block);
+      return NULL;
+    }
+  if (asize == 0)
+    return NULL;
+
+  have = block_size (old_block);
+  if (asize <= have || grow_in_place (old_block, asize))
+    {
+      /* Give back what is not needed. */
+      have = block_size (old_block);
+      if (have - asize >= MIN_BLOCK)
+        {
+          set_tags (old_block, asize, true);
+          set_tags (next_block (old_block), have - asize, false);
+          coalesce (next_block (old_block));
+        }
+      return old_block;
+    }
+
+  new_block = malloc (new_size);
+  if (new_block == NULL)
+    return NULL;
+  memcpy (new_block, old_block, have - 2 * TAG_SIZE);
+  free (old_block);
+  return new_block;
+}
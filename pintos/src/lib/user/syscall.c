@@ -209,11 +209,46 @@ diskreadwritecount (const long long *read_count, const long long *write_count)
   return syscall2 (SYS_DISKREADWRITECOUNT, read_count, write_count);
 }
 
+bool
+fsync (int fd)
+{
+  return syscall1 (SYS_FSYNC, fd);
+}
+
+bool
+fdatasync (int fd)
+{
+  return syscall1 (SYS_FDATASYNC, fd);
+}
+
+void
+blocktrace (void)
+{
+  syscall0 (SYS_BLOCKTRACE);
+}
+
+bool
+setshares (int shares)
+{
+  return syscall1 (SYS_SETSHARES, shares);
+}
+
+bool
+edf (int period, int budget, int deadline)
+{
+  return syscall3 (SYS_EDF, period, budget, deadline);
+}
+
+void
+edfstat (int *misses, int *overruns)
+{
+  syscall2 (SYS_EDFSTAT, misses, overruns);
+}
+
 
 void*
 sbrk (intptr_t increment)
 {
-  /* Homework 5, Part B: YOUR CODE HERE */
-  return NULL;
+  return (void *) syscall1 (SYS_SBRK, increment);
 }
 
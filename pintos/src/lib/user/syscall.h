@@ -46,6 +46,15 @@ bool mkdir (const char *dir);
 bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
+void cacheinv (void);
+int cachestat (const long long *access_count, const long long *hit_count);
+int diskreadwritecount (const long long *read_count, const long long *write_count);
+bool fsync (int fd);
+bool fdatasync (int fd);
+void blocktrace (void);
+bool setshares (int shares);
+bool edf (int period, int budget, int deadline);
+void edfstat (int *misses, int *overruns);
 
 /* Homework 5, Part B. */
 void* sbrk (intptr_t increment);
@@ -0,0 +1,52 @@
+/* Writes a file, syncs it with fsync(), and checks that its data
+   reached the disk while it stayed in the cache. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BLOCK_SECTOR_SIZE 512
+#define BUF_SECTORS 16
+#define BUF_SIZE (BLOCK_SECTOR_SIZE * BUF_SECTORS)
+
+static char buf[BUF_SIZE];
+
+void
+test_main (void)
+{
+  const char *file_name = "db";
+  long long read_count, write_count, base_writes;
+  long long num_accesses, num_hits, base_accesses, base_hits;
+  int fd;
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  random_bytes (buf, sizeof buf);
+  CHECK (write (fd, buf, sizeof buf) == BUF_SIZE,
+         "write %d bytes to \"%s\"", (int) BUF_SIZE, file_name);
+
+  CHECK (diskreadwritecount (&read_count, &write_count) == 0, "disk count");
+  base_writes = write_count;
+  CHECK (fsync (fd), "fsync \"%s\"", file_name);
+  CHECK (diskreadwritecount (&read_count, &write_count) == 0, "disk count");
+  if (write_count - base_writes < BUF_SECTORS)
+    fail ("fsync wrote %lld sectors, expected at least %d",
+          write_count - base_writes, BUF_SECTORS);
+
+  /* The data must still be cached. */
+  CHECK (cachestat (&num_accesses, &num_hits) == 0, "cachestat");
+  base_accesses = num_accesses;
+  base_hits = num_hits;
+  seek (fd, 0);
+  CHECK (read (fd, buf, sizeof buf) == BUF_SIZE,
+         "read %d bytes from \"%s\"", (int) BUF_SIZE, file_name);
+  CHECK (cachestat (&num_accesses, &num_hits) == 0, "cachestat");
+  if (num_hits - base_hits != num_accesses - base_accesses)
+    fail ("read after fsync missed the cache");
+
+  CHECK (fdatasync (fd), "fdatasync \"%s\"", file_name);
+
+  msg ("close \"%s\"", file_name);
+  close (fd);
+}
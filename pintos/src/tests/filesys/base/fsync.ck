@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fsync) begin
+(fsync) create "db"
+(fsync) open "db"
+(fsync) write 8192 bytes to "db"
+(fsync) disk count
+(fsync) fsync "db"
+(fsync) disk count
+(fsync) cachestat
+(fsync) read 8192 bytes from "db"
+(fsync) cachestat
+(fsync) fdatasync "db"
+(fsync) close "db"
+(fsync) end
+EOF
+pass;
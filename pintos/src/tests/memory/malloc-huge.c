@@ -0,0 +1,52 @@
+/* Requests far more memory than a process can have, including
+   sizes that do not fit in sbrk()'s signed increment, and checks
+   that each fails cleanly and leaves the heap usable. */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define NUM_INTS 1000
+
+/* Sizes to request.  Volatile, so that the compiler does not
+   warn about the obviously impossible allocations. */
+static volatile size_t huge_sizes[] =
+  {
+    (size_t) -256, SIZE_MAX, (size_t) PTRDIFF_MAX + 1, PTRDIFF_MAX,
+  };
+
+void
+test_main (void)
+{
+  int* p = calloc(NUM_INTS, sizeof(int));
+  unsigned char* brk = sbrk(0);
+  size_t i;
+
+  ASSERT(p != NULL);
+  for (i = 0; i < sizeof huge_sizes / sizeof *huge_sizes; i++)
+    {
+      ASSERT(malloc(huge_sizes[i]) == NULL);
+      ASSERT(realloc(p, huge_sizes[i]) == NULL);
+    }
+  ASSERT(sbrk(0) == brk);
+
+  for (i = 0; i < NUM_INTS; i++)
+    ASSERT(p[i] == 0);
+  int* q = calloc(NUM_INTS, sizeof(int));
+  ASSERT(q != NULL && q != p);
+  free(p);
+  free(q);
+}
+
+int
+main (int argc UNUSED, char *argv[] UNUSED)
+{
+  test_name = "malloc-huge";
+  msg ("begin");
+  test_main();
+  msg ("end");
+  return 0;
+}
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(malloc-huge) begin
+(malloc-huge) end
+malloc-huge: exit(0)
+EOF
+pass;
@@ -0,0 +1,54 @@
+/* Checks admission control for EDF threads: a reservation must
+   have budget <= deadline <= period, and EDF threads together
+   may not reserve more than EDF_UTIL_MAX of the CPU. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+struct other_info
+  {
+    struct semaphore done;
+    bool half_ok;               /* Admitted for 50%? */
+    bool rest_ok;               /* Admitted for 40%? */
+  };
+
+static thread_func other_thread;
+
+static const char *
+verdict (bool admitted)
+{
+  return admitted ? "admitted" : "rejected";
+}
+
+void
+test_edf_admit (void)
+{
+  struct other_info info;
+
+  msg ("Reserving 5 of every 10 ticks: %s.",
+       verdict (thread_set_edf (10, 5, 10)));
+  msg ("Budget past deadline: %s.", verdict (thread_set_edf (10, 6, 5)));
+  msg ("Deadline past period: %s.", verdict (thread_set_edf (10, 5, 11)));
+
+  sema_init (&info.done, 0);
+  thread_create ("other", PRI_DEFAULT, other_thread, &info);
+  sema_down (&info.done);
+  msg ("Other thread reserving another 50%%: %s.", verdict (info.half_ok));
+  msg ("Other thread reserving another 40%%: %s.", verdict (info.rest_ok));
+
+  msg ("Leaving EDF: %s.", verdict (thread_set_edf (0, 0, 0)));
+}
+
+static void
+other_thread (void *info_)
+{
+  struct other_info *info = info_;
+
+  info->half_ok = thread_set_edf (10, 5, 10);
+  info->rest_ok = thread_set_edf (10, 4, 10);
+  thread_set_edf (0, 0, 0);
+  sema_up (&info->done);
+}
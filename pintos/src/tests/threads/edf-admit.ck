@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(edf-admit) begin
+(edf-admit) Reserving 5 of every 10 ticks: admitted.
+(edf-admit) Budget past deadline: rejected.
+(edf-admit) Deadline past period: rejected.
+(edf-admit) Other thread reserving another 50%: rejected.
+(edf-admit) Other thread reserving another 40%: admitted.
+(edf-admit) Leaving EDF: admitted.
+(edf-admit) end
+EOF
+pass;
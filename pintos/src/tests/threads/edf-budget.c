@@ -0,0 +1,97 @@
+/* Checks that an EDF thread is throttled once it overruns its
+   budget, so that it cannot starve ordinary threads.
+
+   An EDF thread reserving 5 of every 20 ticks spins alongside
+   the main thread, an ordinary thread, for 3 periods.  Without
+   throttling, the EDF thread would get all 60 ticks; with it,
+   the main thread should get about 45. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define PERIOD 20
+#define BUDGET 5
+#define PERIOD_CNT 3
+
+struct edf_info
+  {
+    int64_t end_time;           /* When to stop spinning. */
+    volatile bool done;         /* Finished spinning? */
+    int tick_count;             /* Ticks seen while spinning. */
+    int misses, overruns;       /* From thread_get_edf_stats(). */
+    struct semaphore exited;
+  };
+
+static thread_func edf_thread;
+static int spin_until_done (volatile bool *done);
+
+void
+test_edf_budget (void)
+{
+  struct edf_info info;
+  int main_ticks;
+
+  info.end_time = timer_ticks () + PERIOD * PERIOD_CNT;
+  info.done = false;
+  sema_init (&info.exited, 0);
+  thread_create ("edf", PRI_DEFAULT, edf_thread, &info);
+
+  main_ticks = spin_until_done (&info.done);
+  sema_down (&info.exited);
+
+  msg ("EDF thread ran: %s.", info.tick_count > 0 ? "yes" : "no");
+  msg ("Main thread got at least half of the CPU: %s.",
+       main_ticks >= PERIOD * PERIOD_CNT / 2 ? "yes" : "no");
+  msg ("Budget overruns counted: %s.", info.overruns > 0 ? "yes" : "no");
+  msg ("Deadline misses: %d.", info.misses);
+}
+
+/* Spins until *DONE, returning the number of ticks seen. */
+static int
+spin_until_done (volatile bool *done)
+{
+  int64_t last = timer_ticks ();
+  int tick_count = 0;
+
+  while (!*done)
+    {
+      int64_t now = timer_ticks ();
+      if (now != last)
+        {
+          tick_count++;
+          last = now;
+        }
+    }
+  return tick_count;
+}
+
+static void
+edf_thread (void *info_)
+{
+  struct edf_info *info = info_;
+  int64_t last;
+
+  if (!thread_set_edf (PERIOD, BUDGET, PERIOD))
+    fail ("EDF reservation rejected");
+
+  info->tick_count = 0;
+  last = timer_ticks ();
+  while (last < info->end_time)
+    {
+      int64_t now = timer_ticks ();
+      if (now != last)
+        {
+          info->tick_count++;
+          last = now;
+        }
+    }
+
+  thread_get_edf_stats (&info->misses, &info->overruns);
+  thread_set_edf (0, 0, 0);
+  info->done = true;
+  sema_up (&info->exited);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(edf-budget) begin
+(edf-budget) EDF thread ran: yes.
+(edf-budget) Main thread got at least half of the CPU: yes.
+(edf-budget) Budget overruns counted: yes.
+(edf-budget) Deadline misses: 0.
+(edf-budget) end
+EOF
+pass;
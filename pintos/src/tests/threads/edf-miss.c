@@ -0,0 +1,86 @@
+/* Checks that a missed deadline is counted, including one that
+   a job misses while it is still waiting for the CPU.
+
+   Two EDF threads each reserve 30 of every 100 ticks, within 50
+   ticks of the start of the period.  Admission control accepts
+   them, because it looks only at utilization, but when both
+   start spinning at once the second to run cannot get its 30
+   ticks until the first has had its own, by which time its
+   deadline has passed.  Exactly one job should miss. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 2
+#define PERIOD 100
+#define BUDGET 30
+#define DEADLINE 50
+
+struct miss_info
+  {
+    int64_t end_time;           /* When to stop spinning. */
+    struct semaphore ready;     /* Upped by each thread once EDF. */
+    struct semaphore start;     /* Upped by main to start them. */
+    struct semaphore done;      /* Upped by each thread at exit. */
+    int misses;                 /* Total over all threads. */
+  };
+
+static thread_func edf_thread;
+
+void
+test_edf_miss (void)
+{
+  struct miss_info info;
+  int i;
+
+  info.end_time = timer_ticks () + PERIOD - 10;
+  sema_init (&info.ready, 0);
+  sema_init (&info.start, 0);
+  sema_init (&info.done, 0);
+  info.misses = 0;
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      char name[16];
+
+      snprintf (name, sizeof name, "edf %d", i);
+      thread_create (name, PRI_DEFAULT, edf_thread, &info);
+      sema_down (&info.ready);
+    }
+
+  /* Wake both threads at once, as an EDF thread that neither
+     preempts. */
+  if (!thread_set_edf (PERIOD, 5, 10))
+    fail ("EDF reservation rejected");
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_up (&info.start);
+  thread_set_edf (0, 0, 0);
+
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&info.done);
+  msg ("Deadline misses: %d.", info.misses);
+}
+
+static void
+edf_thread (void *info_)
+{
+  struct miss_info *info = info_;
+  int misses, overruns;
+
+  if (!thread_set_edf (PERIOD, BUDGET, DEADLINE))
+    fail ("EDF reservation rejected");
+  sema_up (&info->ready);
+  sema_down (&info->start);
+
+  while (timer_ticks () < info->end_time)
+    continue;
+
+  thread_get_edf_stats (&misses, &overruns);
+  info->misses += misses;
+  thread_set_edf (0, 0, 0);
+  sema_up (&info->done);
+}
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(edf-miss) begin
+(edf-miss) Deadline misses: 1.
+(edf-miss) end
+EOF
+pass;
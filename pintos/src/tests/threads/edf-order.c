@@ -0,0 +1,81 @@
+/* Checks that ready EDF threads run earliest deadline first.
+
+   Three EDF threads, with relative deadlines of 300, 200, and
+   100 ticks, block on a semaphore.  The main thread, itself an
+   EDF thread with an earlier deadline than any of them, wakes
+   them all before it leaves EDF and blocks, so that they should
+   run in the reverse of the order they were created in. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define THREAD_CNT 3
+#define PERIOD 1000
+#define BUDGET 10
+
+struct order_info
+  {
+    struct semaphore ready;     /* Upped by each thread once EDF. */
+    struct semaphore start;     /* Upped by main to start them. */
+    struct semaphore done;      /* Upped by each thread at exit. */
+  };
+
+struct edf_info
+  {
+    struct order_info *order;
+    int deadline;
+  };
+
+static thread_func edf_thread;
+
+void
+test_edf_order (void)
+{
+  struct order_info order;
+  struct edf_info info[THREAD_CNT];
+  int i;
+
+  sema_init (&order.ready, 0);
+  sema_init (&order.start, 0);
+  sema_init (&order.done, 0);
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      char name[16];
+
+      info[i].order = &order;
+      info[i].deadline = 100 * (THREAD_CNT - i);
+      snprintf (name, sizeof name, "edf %d", info[i].deadline);
+      thread_create (name, PRI_DEFAULT, edf_thread, &info[i]);
+      sema_down (&order.ready);
+    }
+
+  msg ("Waking all threads...");
+  if (!thread_set_edf (PERIOD, BUDGET, 50))
+    fail ("EDF reservation rejected");
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_up (&order.start);
+  thread_set_edf (0, 0, 0);
+
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&order.done);
+  msg ("All threads done.");
+}
+
+static void
+edf_thread (void *info_)
+{
+  struct edf_info *info = info_;
+
+  if (!thread_set_edf (PERIOD, BUDGET, info->deadline))
+    fail ("EDF reservation rejected");
+  sema_up (&info->order->ready);
+  sema_down (&info->order->start);
+
+  msg ("Thread with deadline %d running.", info->deadline);
+  thread_set_edf (0, 0, 0);
+  sema_up (&info->order->done);
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(edf-order) begin
+(edf-order) Waking all threads...
+(edf-order) Thread with deadline 100 running.
+(edf-order) Thread with deadline 200 running.
+(edf-order) Thread with deadline 300 running.
+(edf-order) All threads done.
+(edf-order) end
+EOF
+pass;
@@ -0,0 +1,62 @@
+/* Times the page allocator: single pages, and 4-page blocks
+   with the pool fragmented by alternating free and used pages.
+   Run as palloc-bench for the buddy allocator and as
+   palloc-bench-bitmap for the first-fit bitmap scan, and
+   compare the cycle counts. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "devices/tsc.h"
+
+#define ROUNDS 1000             /* Alloc/free pairs timed. */
+#define FRAG_PAGES 128          /* Pages used to fragment the pool. */
+#define BLOCK_PAGES 4           /* Size of multi-page requests. */
+
+static void *frag[FRAG_PAGES];
+
+/* Returns the average cycles to get and free PAGE_CNT pages. */
+static unsigned
+time_pairs (size_t page_cnt)
+{
+  uint64_t start = rdtsc ();
+  int i;
+
+  for (i = 0; i < ROUNDS; i++)
+    {
+      void *p = palloc_get_multiple (0, page_cnt);
+      if (p == NULL)
+        fail ("allocating %zu pages failed", page_cnt);
+      palloc_free_multiple (p, page_cnt);
+    }
+  return (rdtsc () - start) / ROUNDS;
+}
+
+void
+test_palloc_bench (void)
+{
+  unsigned single, block;
+  int i;
+
+  single = time_pairs (1);
+
+  /* Fill the low end of the pool, then free every other page. */
+  for (i = 0; i < FRAG_PAGES; i++)
+    {
+      frag[i] = palloc_get_page (0);
+      if (frag[i] == NULL)
+        fail ("allocating page %d failed", i);
+    }
+  for (i = 0; i < FRAG_PAGES; i += 2)
+    palloc_free_page (frag[i]);
+
+  block = time_pairs (BLOCK_PAGES);
+
+  for (i = 1; i < FRAG_PAGES; i += 2)
+    palloc_free_page (frag[i]);
+
+  msg ("single page: %u cycles per alloc/free", single);
+  msg ("%d pages, fragmented pool: %u cycles per alloc/free",
+       BLOCK_PAGES, block);
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+
+sub check_palloc_bench {
+    our ($test);
+    my (@output) = read_text_file ("$test.output");
+    common_checks ("run", @output);
+    @output = get_core_output ("run", @output);
+
+    my ($single, $block);
+    local ($_);
+    foreach (@output) {
+	$single = $1 if /^\(palloc-bench(?:-bitmap)?\) single page: (\d+) cycles/;
+	$block = $1 if /^\(palloc-bench(?:-bitmap)?\) 4 pages, fragmented pool: (\d+) cycles/;
+    }
+    fail "missing single page timing\n" if !defined $single;
+    fail "missing fragmented pool timing\n" if !defined $block;
+    pass;
+}
+
+1;
@@ -0,0 +1,64 @@
+/* Checks that an object cache hands out distinct objects,
+   constructs each object only once, reuses the most recently
+   freed object first, and gives back its empty slab on
+   kmem_reclaim(). */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/slab.h"
+
+#define OBJ_CNT 10
+#define OBJ_SIZE 100
+
+static int ctor_cnt;
+
+static void
+count_ctor (void *obj UNUSED)
+{
+  ctor_cnt++;
+}
+
+void
+test_slab_cache (void)
+{
+  struct kmem_cache *c;
+  void *objs[OBJ_CNT];
+  void *p;
+  int constructed;
+  int i, j;
+
+  c = kmem_cache_create ("test", OBJ_SIZE, count_ctor);
+
+  for (i = 0; i < OBJ_CNT; i++)
+    {
+      objs[i] = kmem_cache_alloc (c);
+      if (objs[i] == NULL)
+        fail ("allocation %d failed", i);
+      for (j = 0; j < i; j++)
+        if ((char *) objs[i] < (char *) objs[j] + OBJ_SIZE
+            && (char *) objs[j] < (char *) objs[i] + OBJ_SIZE)
+          fail ("objects %d and %d overlap", j, i);
+    }
+  msg ("Allocated %d objects, none overlapping.", OBJ_CNT);
+
+  constructed = ctor_cnt;
+  for (i = 0; i < OBJ_CNT; i++)
+    kmem_cache_free (c, objs[i]);
+  for (i = 0; i < OBJ_CNT; i++)
+    objs[i] = kmem_cache_alloc (c);
+  if (ctor_cnt != constructed)
+    fail ("%d objects constructed again", ctor_cnt - constructed);
+  msg ("Reallocated %d objects without constructing any.", OBJ_CNT);
+
+  p = objs[OBJ_CNT / 2];
+  kmem_cache_free (c, p);
+  objs[OBJ_CNT / 2] = kmem_cache_alloc (c);
+  if (objs[OBJ_CNT / 2] != p)
+    fail ("freed object was not reused");
+  msg ("A freed object is reused first.");
+
+  for (i = 0; i < OBJ_CNT; i++)
+    kmem_cache_free (c, objs[i]);
+  msg ("Reclaimed %zu empty slab(s).", kmem_reclaim ());
+}
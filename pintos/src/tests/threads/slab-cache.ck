@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(slab-cache) begin
+(slab-cache) Allocated 10 objects, none overlapping.
+(slab-cache) Reallocated 10 objects without constructing any.
+(slab-cache) A freed object is reused first.
+(slab-cache) Reclaimed 1 empty slab(s).
+(slab-cache) end
+EOF
+pass;
@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::threads::mlfqs;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+my (@actual);
+local ($_);
+foreach (@output) {
+    my ($id, $count) = /Thread (\d+) received (\d+) ticks\./ or next;
+    $actual[$id] = $count;
+}
+
+# 3000 ticks divided 1:2:3.
+my (@expected) = (500, 1000, 1500);
+mlfqs_compare ("thread", "%d", \@actual, \@expected, 50, [0, 2, 1],
+	       "Some tick counts were missing or differed from those "
+	       . "expected by more than 50.");
+pass;
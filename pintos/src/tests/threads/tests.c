@@ -38,6 +38,14 @@ static const struct test tests[] =
     {"mlfqs-nice-2", test_mlfqs_nice_2},
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
+    {"stride-fair", test_stride_fair},
+    {"edf-admit", test_edf_admit},
+    {"edf-budget", test_edf_budget},
+    {"edf-order", test_edf_order},
+    {"edf-miss", test_edf_miss},
+    {"slab-cache", test_slab_cache},
+    {"palloc-bench", test_palloc_bench},
+    {"palloc-bench-bitmap", test_palloc_bench},
   };
 
 static const char *test_name;
@@ -32,6 +32,13 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+extern test_func test_stride_fair;
+extern test_func test_edf_admit;
+extern test_func test_edf_budget;
+extern test_func test_edf_order;
+extern test_func test_edf_miss;
+extern test_func test_slab_cache;
+extern test_func test_palloc_bench;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
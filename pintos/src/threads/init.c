@@ -34,9 +34,17 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
+#include "devices/partition.h"
+#include "devices/stripe.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/share.h"
+#include "vm/swap.h"
+#endif
 
 /* Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
@@ -49,6 +57,10 @@ static bool format_filesys;
    overriding the defaults. */
 static const char *filesys_bdev_name;
 static const char *scratch_bdev_name;
+
+/* -stripe: Comma-separated names of block devices to stripe
+   together into "md0". */
+static char *stripe_bdev_names;
 #ifdef VM
 static const char *swap_bdev_name;
 #endif
@@ -66,6 +78,9 @@ static void run_actions (char **argv);
 static void usage (void);
 
 #ifdef FILESYS
+static void create_stripe (void);
+static void check_stripe_member (struct block *, struct block *members[],
+                                 size_t member_cnt);
 static void locate_block_devices (void);
 static void locate_block_device (enum block_type, const char *name);
 #endif
@@ -124,10 +139,19 @@ main (void)
 #ifdef FILESYS
   /* Initialize file system. */
   ide_init ();
+  create_stripe ();
   locate_block_devices ();
   filesys_init (format_filesys);
 #endif
 
+#ifdef VM
+  /* Initialize virtual memory. */
+  swap_init ();
+  page_init ();
+  frame_init ();
+  share_init ();
+#endif
+
   printf ("Boot complete.\n");
 
   /* Run actions specified on kernel command line. */
@@ -248,15 +272,50 @@ parse_options (char **argv)
         filesys_bdev_name = value;
       else if (!strcmp (name, "-scratch"))
         scratch_bdev_name = value;
+      else if (!strcmp (name, "-stripe"))
+        stripe_bdev_names = value;
+      else if (!strcmp (name, "-iotrace"))
+        block_trace_enabled = true;
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
 #endif
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-stack"))
+        {
+          int mb = atoi (value);
+          if (mb < 1 || mb > STACK_MAX_MB)
+            PANIC ("-stack must be between 1 and %d", STACK_MAX_MB);
+          page_stack_max = (size_t) mb * 1024 * 1024;
+        }
 #endif
       else if (!strcmp (name, "-rs"))
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-stride"))
+        thread_stride = true;
+      else if (!strcmp (name, "-palloc"))
+        {
+          if (value != NULL && !strcmp (value, "bitmap"))
+            palloc_bitmap = true;
+          else if (value == NULL || strcmp (value, "buddy"))
+            PANIC ("-palloc must be \"buddy\" or \"bitmap\"");
+        }
+      else if (!strcmp (name, "-hz"))
+        {
+          timer_freq = atoi (value);
+          if (timer_freq < TIMER_FREQ_MIN || timer_freq > TIMER_FREQ_MAX)
+            PANIC ("-hz must be between %d and %d",
+                   TIMER_FREQ_MIN, TIMER_FREQ_MAX);
+        }
+      else if (!strcmp (name, "-slice"))
+        {
+          thread_time_slice = atoi (value);
+          if (thread_time_slice < 1)
+            PANIC ("-slice must be at least 1 tick");
+        }
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
@@ -265,6 +324,9 @@ parse_options (char **argv)
         PANIC ("unknown option `%s' (use -h for help)", name);
     }
 
+  if (thread_mlfqs && thread_stride)
+    PANIC ("-mlfqs and -stride cannot be used together");
+
   /* Initialize the random number generator based on the system
      time.  This has no effect if an "-rs" option was specified.
 
@@ -374,12 +436,22 @@ usage (void)
           "  -f                 Format file system device during startup.\n"
           "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
+          "  -stripe=BDEV,...   Stripe BDEVs, unpartitioned disks, into md0,\n"
+          "                     the default file system.\n"
+          "  -iotrace           Trace block I/O, dump it at power off.\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
 #endif
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -stride            Use stride (proportional-share) scheduler.\n"
+          "  -palloc=ALLOCATOR  Use buddy (default) or bitmap page allocator.\n"
+          "  -hz=FREQ           Interrupt FREQ times a second (default 100).\n"
+          "  -slice=TICKS       Give each thread TICKS ticks to run (default 4).\n"
+#ifdef VM
+          "  -stack=MB          Let user stacks grow to MB megabytes (default 8).\n"
+#endif
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -388,6 +460,68 @@ usage (void)
 }
 
 #ifdef FILESYS
+/* Stripes the block devices named by -stripe, if any, into a
+   RAID-0 device "md0", which becomes the file system device
+   unless -filesys says otherwise. */
+static void
+create_stripe (void)
+{
+  struct block *members[STRIPE_MAX_MEMBERS];
+  size_t member_cnt = 0;
+  char *name, *save_ptr;
+
+  if (stripe_bdev_names == NULL)
+    return;
+
+  for (name = strtok_r (stripe_bdev_names, ",", &save_ptr); name != NULL;
+       name = strtok_r (NULL, ",", &save_ptr))
+    {
+      struct block *block = block_get_by_name (name);
+      if (block == NULL)
+        PANIC ("No such block device \"%s\"", name);
+      if (member_cnt >= STRIPE_MAX_MEMBERS)
+        PANIC ("Too many devices to stripe (max %d)", STRIPE_MAX_MEMBERS);
+      check_stripe_member (block, members, member_cnt);
+      members[member_cnt++] = block;
+    }
+  if (member_cnt < 2)
+    PANIC ("-stripe needs at least two block devices");
+
+  stripe_create ("md0", BLOCK_FILESYS, members, member_cnt);
+  if (filesys_bdev_name == NULL)
+    filesys_bdev_name = "md0";
+}
+
+/* Panics unless BLOCK, which is to be added to the MEMBER_CNT
+   MEMBERS already chosen, can safely be striped.  Striping
+   overwrites every sector of a member, so it must be a whole
+   disk that holds no partitions, in particular not the kernel,
+   and that has not been given another role. */
+static void
+check_stripe_member (struct block *block, struct block *members[],
+                     size_t member_cnt)
+{
+  const char *name = block_name (block);
+  size_t i;
+
+  if (block_type (block) != BLOCK_RAW)
+    PANIC ("Cannot stripe %s: not a whole disk", name);
+  if (partition_found_type (block, BLOCK_KERNEL))
+    PANIC ("Cannot stripe %s: it is the boot device", name);
+  if (partition_found (block))
+    PANIC ("Cannot stripe %s: it has partitions", name);
+  if ((filesys_bdev_name != NULL && !strcmp (name, filesys_bdev_name))
+      || (scratch_bdev_name != NULL && !strcmp (name, scratch_bdev_name))
+#ifdef VM
+      || (swap_bdev_name != NULL && !strcmp (name, swap_bdev_name))
+#endif
+      )
+    PANIC ("Cannot stripe %s: it is already in use", name);
+  for (i = 0; i < member_cnt; i++)
+    if (members[i] == block)
+      PANIC ("Cannot stripe %s twice", name);
+}
+
 /* Figure out what block devices to cast in the various Pintos roles. */
 static void
 locate_block_devices (void)
@@ -9,6 +9,9 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "devices/timer.h"
+#ifdef USERPROG
+#include "userprog/gdt.h"
+#endif
 
 /* Programmable Interrupt Controller (PIC) registers.
    A PC has two PICs, called the master and slave PICs, with the
@@ -361,6 +364,13 @@ intr_handler (struct intr_frame *frame)
       yield_on_return = false;
     }
 
+  /* Time until now was spent in user mode, if that is where we
+     came from. */
+#ifdef USERPROG
+  if (frame->cs == SEL_UCSEG)
+    thread_charge_cycles (true);
+#endif
+
   /* Invoke the interrupt's handler. */
   handler = intr_handlers[frame->vec_no];
   if (handler != NULL)
@@ -386,6 +396,12 @@ intr_handler (struct intr_frame *frame)
       if (yield_on_return)
         thread_yield ();
     }
+
+  /* Time from here on is user time again. */
+#ifdef USERPROG
+  if (frame->cs == SEL_UCSEG)
+    thread_charge_cycles (false);
+#endif
 }
 
 /* Handles an unexpected interrupt with interrupt frame F.  An
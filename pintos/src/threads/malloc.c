@@ -6,7 +6,9 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/palloc.h"
+#include "threads/slab.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* A simple implementation of malloc().
@@ -32,7 +34,32 @@
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.
+
+   In front of the descriptors, each thread keeps a "magazine"
+   of recently freed blocks for each size class, linked through
+   their first words, in its struct thread.  free() puts a block
+   in the running thread's magazine and malloc() takes one from
+   it, neither taking a lock.  Only when a magazine is empty does
+   malloc() lock the descriptor, and then it moves MAG_BATCH
+   blocks at once; likewise free() moves MAG_BATCH blocks back
+   when a magazine holds MAG_MAX.  Blocks in magazines count as
+   in use as far as their arenas are concerned.  A thread's
+   magazines are emptied when it exits.
+
+   So that a descriptor hovering around an arena boundary does
+   not allocate and free the same page over and over, it keeps
+   up to EMPTY_ARENA_MAX arenas with no blocks in use before
+   giving any back to the page allocator. */
+
+/* Most blocks a magazine holds. */
+#define MAG_MAX 16
+
+/* Blocks moved at a time between a magazine and its descriptor. */
+#define MAG_BATCH 8
+
+/* Arenas without blocks in use that a descriptor keeps. */
+#define EMPTY_ARENA_MAX 1
 
 /* Descriptor. */
 struct desc
@@ -40,6 +67,7 @@ struct desc
     size_t block_size;          /* Size of each element in bytes. */
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
     struct list free_list;      /* List of free blocks. */
+    size_t empty_cnt;           /* Arenas with no blocks in use. */
     struct lock lock;           /* Lock. */
   };
 
@@ -61,11 +89,13 @@ struct block
   };
 
 /* Our set of descriptors. */
-static struct desc descs[10];   /* Descriptors. */
+static struct desc descs[MALLOC_CLASS_CNT];  /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static bool refill (struct desc *, struct malloc_magazine *);
+static void drain (struct desc *, struct malloc_magazine *, size_t cnt);
 
 /* Initializes the malloc() descriptors. */
 void
@@ -80,8 +110,10 @@ malloc_init (void)
       d->block_size = block_size;
       d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
       list_init (&d->free_list);
+      d->empty_cnt = 0;
       lock_init (&d->lock);
     }
+  ASSERT (desc_cnt == MALLOC_CLASS_CNT);
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
@@ -90,7 +122,8 @@ void *
 malloc (size_t size)
 {
   struct desc *d;
-  struct block *b;
+  struct malloc_magazine *m;
+  void *b;
   struct arena *a;
 
   /* A null pointer satisfies a request for 0 bytes. */
@@ -108,6 +141,8 @@ malloc (size_t size)
          Allocate enough pages to hold SIZE plus an arena. */
       size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
       a = palloc_get_multiple (0, page_cnt);
+      if (a == NULL && kmem_reclaim () > 0)
+        a = palloc_get_multiple (0, page_cnt);
       if (a == NULL)
         return NULL;
 
@@ -119,25 +154,46 @@ malloc (size_t size)
       return a + 1;
     }
 
+  /* Take a block from our magazine, refilling it if need be. */
+  m = &thread_current ()->magazines[d - descs];
+  if (m->cnt == 0 && !refill (d, m))
+    return NULL;
+  b = m->top;
+  m->top = *(void **) b;
+  m->cnt--;
+  return b;
+}
+
+/* Moves up to MAG_BATCH blocks from descriptor D to magazine M,
+   which must be empty, creating an arena if D has no free
+   blocks.  Returns false if memory is not available. */
+static bool
+refill (struct desc *d, struct malloc_magazine *m)
+{
   lock_acquire (&d->lock);
 
   /* If the free list is empty, create a new arena. */
   if (list_empty (&d->free_list))
     {
+      struct arena *a;
       size_t i;
 
-      /* Allocate a page. */
+      /* Allocate a page, taking back the object caches' empty
+         slabs if we have to. */
       a = palloc_get_page (0);
+      if (a == NULL && kmem_reclaim () > 0)
+        a = palloc_get_page (0);
       if (a == NULL)
         {
           lock_release (&d->lock);
-          return NULL;
+          return false;
         }
 
       /* Initialize arena and add its blocks to the free list. */
       a->magic = ARENA_MAGIC;
       a->desc = d;
       a->free_cnt = d->blocks_per_arena;
+      d->empty_cnt++;
       for (i = 0; i < d->blocks_per_arena; i++)
         {
           struct block *b = arena_to_block (a, i);
@@ -145,12 +201,75 @@ malloc (size_t size)
         }
     }
 
-  /* Get a block from free list and return it. */
-  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-  a = block_to_arena (b);
-  a->free_cnt--;
+  /* Move blocks from the free list into the magazine. */
+  while (m->cnt < MAG_BATCH && !list_empty (&d->free_list))
+    {
+      struct block *b = list_entry (list_pop_front (&d->free_list),
+                                    struct block, free_elem);
+      struct arena *a = block_to_arena (b);
+      if (a->free_cnt-- == d->blocks_per_arena)
+        d->empty_cnt--;
+      *(void **) b = m->top;
+      m->top = b;
+      m->cnt++;
+    }
   lock_release (&d->lock);
-  return b;
+  return true;
+}
+
+/* Moves CNT blocks from magazine M back to descriptor D.  An
+   arena left with no blocks in use is given back to the page
+   allocator, unless D has fewer than EMPTY_ARENA_MAX such. */
+static void
+drain (struct desc *d, struct malloc_magazine *m, size_t cnt)
+{
+  ASSERT (cnt <= m->cnt);
+
+  lock_acquire (&d->lock);
+  while (cnt-- > 0)
+    {
+      struct block *b = m->top;
+      struct arena *a = block_to_arena (b);
+
+      m->top = *(void **) b;
+      m->cnt--;
+
+      /* Add block to free list. */
+      list_push_front (&d->free_list, &b->free_elem);
+
+      /* If the arena is now entirely unused, keep it or free it. */
+      if (++a->free_cnt >= d->blocks_per_arena)
+        {
+          ASSERT (a->free_cnt == d->blocks_per_arena);
+          if (d->empty_cnt < EMPTY_ARENA_MAX)
+            d->empty_cnt++;
+          else
+            {
+              size_t i;
+
+              for (i = 0; i < d->blocks_per_arena; i++)
+                {
+                  struct block *b = arena_to_block (a, i);
+                  list_remove (&b->free_elem);
+                }
+              palloc_free_page (a);
+            }
+        }
+    }
+  lock_release (&d->lock);
+}
+
+/* Empties the running thread's magazines back into the
+   descriptors.  Called when the thread exits. */
+void
+malloc_thread_exit (void)
+{
+  struct thread *t = thread_current ();
+  size_t i;
+
+  for (i = 0; i < desc_cnt; i++)
+    if (t->magazines[i].cnt > 0)
+      drain (&descs[i], &t->magazines[i], t->magazines[i].cnt);
 }
 
 /* Allocates and return A times B bytes initialized to zeroes.
@@ -176,7 +295,7 @@ calloc (size_t a, size_t b)
 
 /* Returns the number of bytes allocated for BLOCK. */
 static size_t
-block_size (void *block)
+allocated_size (void *block)
 {
   struct block *b = block;
   struct arena *a = block_to_arena (b);
@@ -204,7 +323,7 @@ realloc (void *old_block, size_t new_size)
       void *new_block = malloc (new_size);
       if (old_block != NULL && new_block != NULL)
         {
-          size_t old_size = block_size (old_block);
+          size_t old_size = allocated_size (old_block);
           size_t min_size = new_size < old_size ? new_size : old_size;
           memcpy (new_block, old_block, min_size);
           free (old_block);
@@ -233,26 +352,15 @@ free (void *p)
           memset (b, 0xcc, d->block_size);
 #endif
 
-          lock_acquire (&d->lock);
-
-          /* Add block to free list. */
-          list_push_front (&d->free_list, &b->free_elem);
-
-          /* If the arena is now entirely unused, free it. */
-          if (++a->free_cnt >= d->blocks_per_arena)
-            {
-              size_t i;
-
-              ASSERT (a->free_cnt == d->blocks_per_arena);
-              for (i = 0; i < d->blocks_per_arena; i++)
-                {
-                  struct block *b = arena_to_block (a, i);
-                  list_remove (&b->free_elem);
-                }
-              palloc_free_page (a);
-            }
-
-          lock_release (&d->lock);
+          /* Put the block in our magazine, first making room
+             if it is full. */
+          struct malloc_magazine *m;
+          m = &thread_current ()->magazines[d - descs];
+          if (m->cnt >= MAG_MAX)
+            drain (d, m, MAG_BATCH);
+          *(void **) b = m->top;
+          m->top = b;
+          m->cnt++;
         }
       else
         {
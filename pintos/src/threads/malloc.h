@@ -4,7 +4,18 @@
 #include <debug.h>
 #include <stddef.h>
 
+/* Number of block sizes malloc() has descriptors for. */
+#define MALLOC_CLASS_CNT 7
+
+/* Recently freed blocks of one size, kept by a thread. */
+struct malloc_magazine
+  {
+    void *top;                  /* Most recently freed block. */
+    size_t cnt;                 /* Number of blocks. */
+  };
+
 void malloc_init (void);
+void malloc_thread_exit (void);
 void *malloc (size_t) __attribute__ ((malloc));
 void *calloc (size_t, size_t) __attribute__ ((malloc));
 void *realloc (void *, size_t);
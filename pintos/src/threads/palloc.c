@@ -2,11 +2,13 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -23,7 +25,51 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Within a pool, free pages are managed by a binary buddy
+   allocator.  Free memory is kept as blocks of 2**ORDER pages,
+   aligned (relative to the pool's base) to their own size, on
+   one free list per order; the list element lives in the free
+   block's first page.  A request for N pages takes a block of
+   the smallest order that holds N pages, splitting a bigger
+   block in halves if need be, and gives back the pages past N.
+   When a block is freed, it is merged with its "buddy", the
+   other half of the block it was split from, for as long as
+   the buddy is free too.  Single pages thus come straight off
+   the order-0 list, and anything else costs O(log n).
+
+   Blocks are at most 2**(ORDER_CNT - 1) pages.  A bigger request,
+   which is rare, falls back to a first-fit scan of used_map for
+   enough free pages in a row, and then takes the free blocks that
+   cover them off the free lists, giving back whatever parts of
+   those blocks lie outside the run.
+
+   The buddy free lists are protected by disabling interrupts
+   rather than by the pool's lock, because thread_schedule_tail()
+   frees dying threads' pages with interrupts off, where it could
+   not wait for a lock.  Every operation is short.
+
+   The "-palloc=bitmap" option switches back to a first-fit scan
+   of the used_map bitmap, for comparison.
+
+   Zeroing pages for PAL_ZERO requests is mostly done ahead of
+   time: when the CPU would otherwise be idle, the idle thread
+   calls palloc_prezero(), which allocates free pages, zeroes
+   them and keeps up to ZEROED_MAX of them per pool on a list.
+   A single-page PAL_ZERO request takes one of these if it can.
+   They are given back to the allocator as soon as a request
+   cannot be met otherwise. */
+
+/* Pre-zeroed pages to keep per pool. */
+#define ZEROED_MAX 64
+
+/* Orders of buddy blocks: 2**0 through 2**(ORDER_CNT - 1) pages. */
+#define ORDER_CNT 11
+
+/* Entry in free_order[] for a page that does not begin a free
+   block. */
+#define NOT_FREE 0xff
 
 /* A memory pool. */
 struct pool
@@ -31,14 +77,38 @@ struct pool
     struct lock lock;                   /* Mutual exclusion. */
     struct bitmap *used_map;            /* Bitmap of free pages. */
     uint8_t *base;                      /* Base of pool. */
+    size_t page_cnt;                    /* Number of pages. */
+
+    /* Buddy allocator. */
+    uint8_t *free_order;                /* Per page: order or NOT_FREE. */
+    struct list free_lists[ORDER_CNT];  /* Free blocks, by order. */
+    size_t free_cnt[ORDER_CNT];         /* Length of each free list. */
+
+    /* Pre-zeroed pages, kept allocated. */
+    struct list zeroed;                 /* Zeroed pages, by first word. */
+    size_t zeroed_cnt;                  /* Length of ZEROED. */
   };
 
+/* PAL_ZERO single-page requests met from and not from the
+   pre-zeroed pages. */
+static long long zero_hit_cnt, zero_miss_cnt;
+
+/* Use the first-fit bitmap scan instead of the buddy allocator?
+   Set by "-palloc=bitmap". */
+bool palloc_bitmap;
+
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static size_t buddy_alloc (struct pool *, size_t page_cnt);
+static void *get_pages (struct pool *, size_t page_cnt);
+static void *take_zeroed (struct pool *);
+static bool release_zeroed (struct pool *);
+static void zero_pages (void *, size_t page_cnt);
+static void buddy_free (struct pool *, size_t page_idx, size_t page_cnt);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -61,6 +131,13 @@ palloc_init (size_t user_page_limit)
              user_pages, "user pool");
 }
 
+/* Returns the number of pages in the user pool. */
+size_t
+palloc_user_page_cnt (void)
+{
+  return user_pool.page_cnt;
+}
+
 /* Obtains and returns a group of PAGE_CNT contiguous free pages.
    If PAL_USER is set, the pages are obtained from the user pool,
    otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
@@ -72,24 +149,29 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
   void *pages;
-  size_t page_idx;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
+  if ((flags & PAL_ZERO) && page_cnt == 1
+      && (pages = take_zeroed (pool)) != NULL)
+    {
+      zero_hit_cnt++;
+      return pages;
+    }
 
-  if (page_idx != BITMAP_ERROR)
-    pages = pool->base + PGSIZE * page_idx;
-  else
-    pages = NULL;
+  pages = get_pages (pool, page_cnt);
+  if (pages == NULL && release_zeroed (pool))
+    pages = get_pages (pool, page_cnt);
 
   if (pages != NULL)
     {
       if (flags & PAL_ZERO)
-        memset (pages, 0, PGSIZE * page_cnt);
+        {
+          zero_pages (pages, page_cnt);
+          if (page_cnt == 1)
+            zero_miss_cnt++;
+        }
     }
   else
     {
@@ -100,6 +182,118 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   return pages;
 }
 
+/* Takes PAGE_CNT contiguous free pages from POOL and returns
+   the first, or a null pointer if there are not enough. */
+static void *
+get_pages (struct pool *pool, size_t page_cnt)
+{
+  size_t page_idx;
+
+  if (palloc_bitmap)
+    {
+      lock_acquire (&pool->lock);
+      page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+      lock_release (&pool->lock);
+    }
+  else
+    {
+      enum intr_level old_level = intr_disable ();
+      page_idx = buddy_alloc (pool, page_cnt);
+      if (page_idx != BITMAP_ERROR)
+        bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+      intr_set_level (old_level);
+    }
+
+  return page_idx != BITMAP_ERROR ? pool->base + PGSIZE * page_idx : NULL;
+}
+
+/* Fills the PAGE_CNT pages at PAGES with zeros. */
+static void
+zero_pages (void *pages, size_t page_cnt)
+{
+  size_t cnt = PGSIZE / sizeof (uint32_t) * page_cnt;
+
+  /* See [IA32-v2b] "REP" and "STOS". */
+  asm volatile ("cld; rep stosl"
+                : "+D" (pages), "+c" (cnt) : "a" (0) : "memory");
+}
+
+/* Takes a pre-zeroed page from POOL, or returns a null pointer
+   if there are none. */
+static void *
+take_zeroed (struct pool *pool)
+{
+  struct list_elem *e = NULL;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  if (!list_empty (&pool->zeroed))
+    {
+      e = list_pop_front (&pool->zeroed);
+      pool->zeroed_cnt--;
+    }
+  intr_set_level (old_level);
+
+  /* Clear the list element that was kept in the page. */
+  if (e != NULL)
+    memset (e, 0, sizeof *e);
+  return e;
+}
+
+/* Gives POOL's pre-zeroed pages back to the allocator.  Returns
+   true if there were any. */
+static bool
+release_zeroed (struct pool *pool)
+{
+  bool released = false;
+  void *page;
+
+  while ((page = take_zeroed (pool)) != NULL)
+    {
+      palloc_free_page (page);
+      released = true;
+    }
+  return released;
+}
+
+/* Zeroes a free page and sets it aside for a later PAL_ZERO
+   request, unless both pools already have ZEROED_MAX such pages
+   or have no free pages.  Returns true if it zeroed a page.
+
+   Called by the idle thread, with interrupts on, so it must
+   never block; the bitmap allocator, which takes the pool's
+   lock, does not get pre-zeroed pages. */
+bool
+palloc_prezero (void)
+{
+  struct pool *pools[2] = { &kernel_pool, &user_pool };
+  size_t i;
+
+  if (palloc_bitmap)
+    return false;
+
+  for (i = 0; i < sizeof pools / sizeof *pools; i++)
+    {
+      struct pool *pool = pools[i];
+      enum intr_level old_level;
+      void *page;
+
+      if (pool->zeroed_cnt >= ZEROED_MAX)
+        continue;
+      page = get_pages (pool, 1);
+      if (page == NULL)
+        continue;
+
+      zero_pages (page, 1);
+      old_level = intr_disable ();
+      list_push_front (&pool->zeroed, page);
+      pool->zeroed_cnt++;
+      intr_set_level (old_level);
+      return true;
+    }
+  return false;
+}
+
 /* Obtains a single free page and returns its kernel virtual
    address.
    If PAL_USER is set, the page is obtained from the user pool,
@@ -119,6 +313,7 @@ palloc_free_multiple (void *pages, size_t page_cnt)
 {
   struct pool *pool;
   size_t page_idx;
+  enum intr_level old_level;
 
   ASSERT (pg_ofs (pages) == 0);
   if (pages == NULL || page_cnt == 0)
@@ -137,8 +332,12 @@ palloc_free_multiple (void *pages, size_t page_cnt)
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
+  old_level = intr_disable ();
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
   bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  if (!palloc_bitmap)
+    buddy_free (pool, page_idx, page_cnt);
+  intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -148,15 +347,60 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Prints how fragmented the free memory of POOL, named NAME,
+   is: the free blocks of each order, and the largest request
+   that could succeed. */
+static void
+print_pool_stats (struct pool *pool, const char *name)
+{
+  size_t free_cnt[ORDER_CNT];
+  size_t free_pages = 0;
+  int largest = -1;
+  enum intr_level old_level;
+  int order;
+
+  if (palloc_bitmap)
+    return;
+
+  old_level = intr_disable ();
+  memcpy (free_cnt, pool->free_cnt, sizeof free_cnt);
+  intr_set_level (old_level);
+
+  printf ("%s: free blocks by order:", name);
+  for (order = 0; order < ORDER_CNT; order++)
+    {
+      printf (" %zu", free_cnt[order]);
+      free_pages += free_cnt[order] << order;
+      if (free_cnt[order] > 0)
+        largest = order;
+    }
+  printf ("\n%s: %zu free pages, largest free block %zu pages\n",
+          name, free_pages, largest >= 0 ? (size_t) 1 << largest : 0);
+}
+
+/* Prints fragmentation statistics for both pools, and how
+   often pre-zeroed pages were available. */
+void
+palloc_print_stats (void)
+{
+  print_pool_stats (&kernel_pool, "Kernel pool");
+  print_pool_stats (&user_pool, "User pool");
+  printf ("Pre-zeroed pages: %lld hits, %lld misses\n",
+          zero_hit_cnt, zero_miss_cnt);
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
+  /* We'll put the pool's used_map and free_order at its base.
+     Calculate the space needed for them and subtract it from
+     the pool's size. */
+  size_t bm_size = ROUND_UP (bitmap_buf_size (page_cnt), sizeof (long));
+  size_t bm_pages = DIV_ROUND_UP (bm_size + page_cnt, PGSIZE);
+  int order;
+
   if (bm_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
   page_cnt -= bm_pages;
@@ -165,8 +409,176 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
 
   /* Initialize the pool. */
   lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_size);
   p->base = base + bm_pages * PGSIZE;
+  p->page_cnt = page_cnt;
+  list_init (&p->zeroed);
+  p->zeroed_cnt = 0;
+
+  /* Put all of its pages on the buddy free lists. */
+  p->free_order = (uint8_t *) base + bm_size;
+  memset (p->free_order, NOT_FREE, page_cnt);
+  for (order = 0; order < ORDER_CNT; order++)
+    {
+      list_init (&p->free_lists[order]);
+      p->free_cnt[order] = 0;
+    }
+  buddy_free (p, 0, page_cnt);
+}
+
+/* Returns the free list element in the first page of POOL's
+   block that begins at page PAGE_IDX. */
+static struct list_elem *
+block_elem (struct pool *pool, size_t page_idx)
+{
+  return (struct list_elem *) (pool->base + PGSIZE * page_idx);
+}
+
+/* Puts the block of 2**ORDER pages at PAGE_IDX on POOL's free
+   lists, without merging it with its buddy. */
+static void
+push_block (struct pool *pool, size_t page_idx, int order)
+{
+  pool->free_order[page_idx] = order;
+  list_push_front (&pool->free_lists[order], block_elem (pool, page_idx));
+  pool->free_cnt[order]++;
+}
+
+/* Takes the block of 2**ORDER pages at PAGE_IDX off POOL's
+   free lists. */
+static void
+remove_block (struct pool *pool, size_t page_idx, int order)
+{
+  ASSERT (pool->free_order[page_idx] == order);
+  pool->free_order[page_idx] = NOT_FREE;
+  list_remove (block_elem (pool, page_idx));
+  pool->free_cnt[order]--;
+}
+
+/* Frees the block of 2**ORDER pages at PAGE_IDX in POOL,
+   merging it with its buddy as long as the buddy is free. */
+static void
+free_block (struct pool *pool, size_t page_idx, int order)
+{
+  while (order < ORDER_CNT - 1)
+    {
+      size_t buddy = page_idx ^ ((size_t) 1 << order);
+      if (buddy + ((size_t) 1 << order) > pool->page_cnt
+          || pool->free_order[buddy] != order)
+        break;
+      remove_block (pool, buddy, order);
+      if (buddy < page_idx)
+        page_idx = buddy;
+      order++;
+    }
+  push_block (pool, page_idx, order);
+}
+
+/* Frees the PAGE_CNT pages at PAGE_IDX in POOL, as the largest
+   aligned blocks that they divide into. */
+static void
+buddy_free (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  size_t end = page_idx + page_cnt;
+
+  while (page_idx < end)
+    {
+      int order = 0;
+      while (order < ORDER_CNT - 1
+             && page_idx % ((size_t) 2 << order) == 0
+             && page_idx + ((size_t) 2 << order) <= end)
+        order++;
+      free_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+    }
+}
+
+/* Returns the order of the free block in POOL that contains
+   page PAGE_IDX, which must be free, and stores the index of the
+   block's first page in *HEAD. */
+static int
+find_block (struct pool *pool, size_t page_idx, size_t *head)
+{
+  int order;
+
+  for (order = 0; order < ORDER_CNT; order++)
+    {
+      *head = page_idx & ~(((size_t) 1 << order) - 1);
+      if (pool->free_order[*head] == order)
+        return order;
+    }
+  NOT_REACHED ();
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL, more than the
+   biggest block holds, and returns the index of the first, or
+   BITMAP_ERROR if there are not that many free pages in a row. */
+static size_t
+buddy_alloc_large (struct pool *pool, size_t page_cnt)
+{
+  size_t start = bitmap_scan (pool->used_map, 0, page_cnt, false);
+  size_t end = start + page_cnt;
+  size_t page_idx;
+
+  if (start == BITMAP_ERROR)
+    return BITMAP_ERROR;
+
+  /* Take every free block that overlaps the run, giving back the
+     parts outside it.  Giving back the part before the run may
+     merge it with a block still in the run, so each block is
+     looked up afresh. */
+  for (page_idx = start; page_idx < end; )
+    {
+      size_t head;
+      int order = find_block (pool, page_idx, &head);
+      size_t block_end = head + ((size_t) 1 << order);
+
+      remove_block (pool, head, order);
+      if (head < start)
+        buddy_free (pool, head, start - head);
+      if (block_end > end)
+        buddy_free (pool, end, block_end - end);
+      page_idx = block_end;
+    }
+  return start;
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL and returns the
+   index of the first, or BITMAP_ERROR if no free block is big
+   enough. */
+static size_t
+buddy_alloc (struct pool *pool, size_t page_cnt)
+{
+  size_t page_idx;
+  int want, order;
+
+  /* Find the smallest order that holds PAGE_CNT pages. */
+  for (want = 0; ((size_t) 1 << want) < page_cnt; want++)
+    if (want == ORDER_CNT - 1)
+      return buddy_alloc_large (pool, page_cnt);
+
+  /* Find the smallest free block at least that big. */
+  for (order = want; order < ORDER_CNT; order++)
+    if (!list_empty (&pool->free_lists[order]))
+      break;
+  if (order == ORDER_CNT)
+    return BITMAP_ERROR;
+
+  page_idx = pg_no (list_front (&pool->free_lists[order]))
+             - pg_no (pool->base);
+  remove_block (pool, page_idx, order);
+
+  /* Split it, freeing the upper halves, until it is the right
+     size, then give back the pages past PAGE_CNT. */
+  while (order > want)
+    {
+      order--;
+      push_block (pool, page_idx + ((size_t) 1 << order), order);
+    }
+  if (page_cnt < (size_t) 1 << want)
+    buddy_free (pool, page_idx + page_cnt,
+                ((size_t) 1 << want) - page_cnt);
+  return page_idx;
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -0,0 +1,345 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* A slab allocator for kernel objects that are allocated and
+   freed often, such as open inodes and files.
+
+   Each object type gets a cache, whose objects all have exactly
+   the type's size instead of malloc()'s next power of 2.  A
+   cache carves pages, called "slabs", into as many objects as
+   fit after a small header, and threads the free objects of
+   each slab into a singly linked list, so that allocating is a
+   pop and freeing is a push.  Slabs that still have free
+   objects are kept on the cache's partial list; allocation
+   takes from the first of them.
+
+   A slab whose objects are all free is kept around, so that a
+   workload that opens and closes files over and over does not
+   keep going back to the page allocator, but only up to
+   EMPTY_MAX of them per cache.  The rest are freed, as are all
+   empty slabs when memory runs short and kmem_reclaim() is
+   called.
+
+   If a cache has a constructor, each object is constructed when
+   its slab is made, and the free list link is kept in a word
+   past the end of the object so as not to disturb it. */
+
+/* Empty slabs that a cache keeps for reuse. */
+#define EMPTY_MAX 2
+
+/* Most caches there may be. */
+#define CACHE_MAX 16
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* A slab: one page of objects, with this header at its start. */
+struct slab
+  {
+    unsigned magic;                     /* Always SLAB_MAGIC. */
+    struct kmem_cache *cache;           /* Owning cache. */
+    struct list_elem elem;              /* In cache's full/partial/empty. */
+    size_t in_use;                      /* Objects allocated. */
+    void *free;                         /* First free object. */
+  };
+
+/* A cache of objects of one size. */
+struct kmem_cache
+  {
+    char name[16];                      /* Name, for statistics. */
+    size_t size;                        /* Object size, as requested. */
+    size_t stride;                      /* Bytes from object to object. */
+    size_t link_ofs;                    /* Offset of free list link. */
+    size_t objs_per_slab;               /* Objects in each slab. */
+    kmem_ctor_func *ctor;               /* Constructor, or null. */
+    struct lock lock;                   /* Protects everything below. */
+    struct list partial;                /* Slabs with free objects. */
+    struct list full;                   /* Slabs without free objects. */
+    struct list empty;                  /* Slabs without allocated objects. */
+    size_t empty_cnt;                   /* Length of EMPTY. */
+
+    /* Statistics. */
+    size_t slab_cnt;                    /* Slabs, empty or not. */
+    size_t in_use;                      /* Objects allocated. */
+    unsigned long long alloc_cnt;       /* Calls to kmem_cache_alloc(). */
+    unsigned long long free_cnt;        /* Calls to kmem_cache_free(). */
+    unsigned long long reclaim_cnt;     /* Empty slabs reclaimed. */
+  };
+
+static struct kmem_cache caches[CACHE_MAX];
+static size_t cache_cnt;
+static struct lock caches_lock;
+
+static struct slab *new_slab (struct kmem_cache *);
+static void free_slab (struct kmem_cache *, struct slab *);
+static struct slab *obj_to_slab (struct kmem_cache *, void *);
+
+/* Returns the free list link of OBJ, an object of cache C. */
+static inline void **
+obj_link (struct kmem_cache *c, void *obj)
+{
+  return (void **) ((uint8_t *) obj + c->link_ofs);
+}
+
+/* Creates and returns a cache named NAME for objects of SIZE
+   bytes.  If CTOR is nonnull, it is run on every object as its
+   slab is created.  Caches are never destroyed. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, kmem_ctor_func *ctor)
+{
+  struct kmem_cache *c;
+
+  if (cache_cnt == 0)
+    lock_init (&caches_lock);
+
+  ASSERT (size > 0);
+  ASSERT (cache_cnt < CACHE_MAX);
+  c = &caches[cache_cnt];
+
+  strlcpy (c->name, name, sizeof c->name);
+  c->size = size;
+  c->ctor = ctor;
+  if (ctor != NULL)
+    {
+      c->link_ofs = ROUND_UP (size, sizeof (void *));
+      c->stride = c->link_ofs + sizeof (void *);
+    }
+  else
+    {
+      c->link_ofs = 0;
+      c->stride = ROUND_UP (size, sizeof (void *));
+    }
+  c->objs_per_slab = (PGSIZE - sizeof (struct slab)) / c->stride;
+  ASSERT (c->objs_per_slab > 0);
+
+  lock_init (&c->lock);
+  list_init (&c->partial);
+  list_init (&c->full);
+  list_init (&c->empty);
+  c->empty_cnt = 0;
+  c->slab_cnt = c->in_use = 0;
+  c->alloc_cnt = c->free_cnt = c->reclaim_cnt = 0;
+
+  lock_acquire (&caches_lock);
+  cache_cnt++;
+  lock_release (&caches_lock);
+  return c;
+}
+
+/* Allocates and returns an object from cache C, or a null
+   pointer if memory is not available.  The object is
+   constructed if C has a constructor and otherwise holds
+   garbage. */
+void *
+kmem_cache_alloc (struct kmem_cache *c)
+{
+  struct slab *s;
+  void *obj;
+
+  lock_acquire (&c->lock);
+  if (list_empty (&c->partial))
+    {
+      if (!list_empty (&c->empty))
+        {
+          list_push_front (&c->partial, list_pop_front (&c->empty));
+          c->empty_cnt--;
+        }
+      else
+        {
+          /* Make a new slab.  Our lock is released meanwhile, so
+             that kmem_reclaim() can take it. */
+          lock_release (&c->lock);
+          s = new_slab (c);
+          if (s == NULL)
+            return NULL;
+          lock_acquire (&c->lock);
+          list_push_front (&c->partial, &s->elem);
+          c->slab_cnt++;
+        }
+    }
+
+  s = list_entry (list_front (&c->partial), struct slab, elem);
+  obj = s->free;
+  s->free = *obj_link (c, obj);
+  if (++s->in_use == c->objs_per_slab)
+    {
+      list_remove (&s->elem);
+      list_push_back (&c->full, &s->elem);
+    }
+  c->in_use++;
+  c->alloc_cnt++;
+  lock_release (&c->lock);
+
+  return obj;
+}
+
+/* Frees OBJ, which must have been allocated from cache C.  If C
+   has a constructor, OBJ must be in its constructed state. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj)
+{
+  struct slab *s, *doomed = NULL;
+
+  if (obj == NULL)
+    return;
+  s = obj_to_slab (c, obj);
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs. */
+  if (c->ctor == NULL)
+    memset (obj, 0xcc, c->size);
+#endif
+
+  lock_acquire (&c->lock);
+  *obj_link (c, obj) = s->free;
+  s->free = obj;
+  if (s->in_use-- == c->objs_per_slab)
+    {
+      list_remove (&s->elem);
+      list_push_front (&c->partial, &s->elem);
+    }
+  if (s->in_use == 0)
+    {
+      list_remove (&s->elem);
+      if (c->empty_cnt < EMPTY_MAX)
+        {
+          list_push_front (&c->empty, &s->elem);
+          c->empty_cnt++;
+        }
+      else
+        {
+          c->slab_cnt--;
+          doomed = s;
+        }
+    }
+  c->in_use--;
+  c->free_cnt++;
+  lock_release (&c->lock);
+
+  if (doomed != NULL)
+    free_slab (c, doomed);
+}
+
+/* Gives the empty slabs of every cache back to the page
+   allocator and returns how many pages that freed.  Called when
+   the kernel pool runs out. */
+size_t
+kmem_reclaim (void)
+{
+  size_t freed = 0;
+  size_t i, cnt;
+
+  if (cache_cnt == 0)
+    return 0;
+
+  lock_acquire (&caches_lock);
+  cnt = cache_cnt;
+  lock_release (&caches_lock);
+
+  for (i = 0; i < cnt; i++)
+    {
+      struct kmem_cache *c = &caches[i];
+      struct list empty;
+
+      list_init (&empty);
+      lock_acquire (&c->lock);
+      while (!list_empty (&c->empty))
+        list_push_back (&empty, list_pop_front (&c->empty));
+      c->slab_cnt -= c->empty_cnt;
+      c->reclaim_cnt += c->empty_cnt;
+      c->empty_cnt = 0;
+      lock_release (&c->lock);
+
+      while (!list_empty (&empty))
+        {
+          free_slab (c, list_entry (list_pop_front (&empty),
+                                    struct slab, elem));
+          freed++;
+        }
+    }
+  return freed;
+}
+
+/* Prints statistics for each cache that has been used. */
+void
+kmem_print_stats (void)
+{
+  size_t i;
+
+  for (i = 0; i < cache_cnt; i++)
+    {
+      struct kmem_cache *c = &caches[i];
+      if (c->alloc_cnt == 0)
+        continue;
+      printf ("Slab %s: %zu-byte objects, %zu per slab, %zu slabs, "
+              "%zu in use, %llu allocs, %llu frees, %llu reclaimed\n",
+              c->name, c->size, c->objs_per_slab, c->slab_cnt, c->in_use,
+              c->alloc_cnt, c->free_cnt, c->reclaim_cnt);
+    }
+}
+
+/* Obtains a page for cache C and carves it into constructed,
+   free objects.  If the kernel pool is empty, reclaims empty
+   slabs from all caches and tries once more.  Returns the new
+   slab, or a null pointer if memory is not available. */
+static struct slab *
+new_slab (struct kmem_cache *c)
+{
+  struct slab *s;
+  uint8_t *obj;
+  size_t i;
+
+  s = palloc_get_page (0);
+  if (s == NULL && kmem_reclaim () > 0)
+    s = palloc_get_page (0);
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->in_use = 0;
+  s->free = NULL;
+
+  /* Thread the objects in address order. */
+  obj = (uint8_t *) s + PGSIZE - (PGSIZE - sizeof *s) % c->stride;
+  for (i = 0; i < c->objs_per_slab; i++)
+    {
+      obj -= c->stride;
+      if (c->ctor != NULL)
+        c->ctor (obj);
+      *obj_link (c, obj) = s->free;
+      s->free = obj;
+    }
+  ASSERT (obj == (uint8_t *) (s + 1));
+  return s;
+}
+
+/* Frees slab S of cache C, which must have no objects in use. */
+static void
+free_slab (struct kmem_cache *c UNUSED, struct slab *s)
+{
+  ASSERT (s->magic == SLAB_MAGIC && s->cache == c);
+  ASSERT (s->in_use == 0);
+  s->magic = 0;
+  palloc_free_page (s);
+}
+
+/* Returns the slab that OBJ, an object of cache C, is in. */
+static struct slab *
+obj_to_slab (struct kmem_cache *c, void *obj)
+{
+  struct slab *s = pg_round_down (obj);
+
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+  ASSERT ((pg_ofs (obj) - sizeof *s) % c->stride == 0);
+  return s;
+}
@@ -0,0 +1,21 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <stddef.h>
+
+/* A cache of fixed-size objects.  See slab.c. */
+struct kmem_cache;
+
+/* Constructor run on each object when its slab is created.
+   Objects must be freed back to the cache in constructed
+   state, so that they need not be constructed again. */
+typedef void kmem_ctor_func (void *obj);
+
+struct kmem_cache *kmem_cache_create (const char *name, size_t size,
+                                      kmem_ctor_func *);
+void *kmem_cache_alloc (struct kmem_cache *);
+void kmem_cache_free (struct kmem_cache *, void *);
+size_t kmem_reclaim (void);
+void kmem_print_stats (void);
+
+#endif /* threads/slab.h */
@@ -1,5 +1,6 @@
 #include "threads/thread.h"
 #include <debug.h>
+#include <inttypes.h>
 #include <stddef.h>
 #include <random.h>
 #include <stdio.h>
@@ -11,8 +12,13 @@
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
+#include "devices/tsc.h"
+#ifdef FILESYS
 #include "filesys/directory.h"
 #include "filesys/file.h"
+#include "threads/slab.h"
+#endif
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
@@ -24,15 +30,22 @@ int fdall = 5;
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Number of distinct priorities. */
+#define PRI_CNT (PRI_MAX - PRI_MIN + 1)
 
-/* List of all processes.  Processes are added to this list
-   when they are first scheduled and removed when they are waited. */
-static struct list all_list;
+/* Processes in THREAD_READY state, that is, processes that are
+   ready to run but not actually running, with one FIFO queue per
+   priority.  Bit P of ready_bitmap is set just when
+   ready_queues[P - PRI_MIN] is nonempty, so that the highest
+   ready priority takes one bit scan to find. */
+static struct list ready_queues[PRI_CNT];
+static uint64_t ready_bitmap;
+static int ready_cnt;           /* Number of threads ready to run. */
 
-static struct lock all_list_lock;
+/* List of all live threads.  Threads are added to this list
+   when they are created and removed when they exit. */
+static struct list all_list;
+static int thread_cnt;          /* Number of threads in all_list. */
 
 /* Idle thread. */
 static struct thread *idle_thread;
@@ -56,15 +69,68 @@ static long long idle_ticks;    /* # of timer ticks spent idle. */
 static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
 static long long user_ticks;    /* # of timer ticks in user programs. */
 
+/* The same, measured in TSC cycles by thread_charge_cycles(),
+   which catches what falls between ticks. */
+static uint64_t idle_cycles;
+static uint64_t kernel_cycles;
+static uint64_t user_cycles;
+static uint64_t last_tsc;       /* TSC when cycles were last charged. */
+
 /* Scheduling. */
-#define TIME_SLICE 4            /* # of timer ticks to give each thread. */
-static unsigned thread_ticks;   /* # of timer ticks since last yield. */
+int thread_time_slice = TIME_SLICE_DEFAULT;
+static int thread_ticks;        /* # of timer ticks since last yield. */
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* If true, use the stride scheduler.  Controlled by kernel
+   command-line option "-stride". */
+bool thread_stride;
+
+/* Stride scheduler: ready threads sit in a binary min-heap of
+   pass values instead of ready_queues.  Each tick a thread runs
+   adds STRIDE1 / shares to its pass, and the lowest pass runs
+   next.  STRIDE_PASS is the pass of the thread last picked, at or
+   below which a thread that was blocked rejoins, so that time
+   spent blocked does not bank CPU.  Any live thread may be ready,
+   so thread_create() refuses to create more than the heap holds. */
+#define STRIDE1 (1 << 20)
+#define STRIDE_HEAP_MAX 1024
+static struct thread *pass_heap[STRIDE_HEAP_MAX];
+static int pass_heap_cnt;
+static uint64_t stride_pass;
+
+/* Earliest-deadline-first class, for periodic threads that
+   reserve a budget of CPU ticks per period.  Ready EDF threads
+   run ahead of all others, earliest deadline first, from
+   edf_ready.  An EDF thread that overruns its budget waits on
+   edf_throttled, in order of release, for its next job.  Both
+   lists are ordered, but only EDF threads are ever on them,
+   which admission control keeps few. */
+static struct list edf_ready;
+static struct list edf_throttled;
+static int edf_util;                    /* Reserved, in 1/1000s. */
+static bool edf_enabled;                /* Has any thread used EDF? */
+static long long edf_miss_cnt;          /* Deadline misses, system-wide. */
+static long long edf_overrun_cnt;       /* Budget overruns, system-wide. */
+
+/* MLFQS: ticks between priority updates, and bounds on nice. */
+#define MLFQS_PRIORITY_TICKS 4
+#define NICE_MIN -20
+#define NICE_MAX 20
+
+/* MLFQS: estimated average number of threads ready to run over
+   the past minute. */
+static fixed_point_t load_avg;
+
+/* MLFQS: threads charged CPU time since the last priority update.
+   Only their recent_cpu changed, so only their priorities need
+   recomputing every MLFQS_PRIORITY_TICKS ticks.  The rest wait
+   for the once-a-second update of every thread. */
+static struct list charged_list;
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
@@ -76,6 +142,20 @@ static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static void ready_push (struct thread *);
+static void ready_remove (struct thread *);
+static void pass_heap_push (struct thread *);
+static struct thread *pass_heap_pop (void);
+static bool ready_outranks (struct thread *);
+static void edf_tick (struct thread *);
+static void edf_new_job (struct thread *, int64_t now);
+static void edf_check_miss (struct thread *, int64_t now);
+static list_less_func edf_deadline_less;
+static list_less_func edf_release_less;
+static void mlfqs_tick (struct thread *);
+static void mlfqs_update_priority (struct thread *);
+static void mlfqs_decay (struct thread *, void *aux);
+static int ready_max_priority (void);
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -93,10 +173,17 @@ static tid_t allocate_tid (void);
 void
 thread_init (void)
 {
+  int i;
+
   ASSERT (intr_get_level () == INTR_OFF);
 
   lock_init (&tid_lock);
-  list_init (&ready_list);
+  for (i = 0; i < PRI_CNT; i++)
+    list_init (&ready_queues[i]);
+  ready_bitmap = 0;
+  list_init (&charged_list);
+  list_init (&edf_ready);
+  list_init (&edf_throttled);
   list_init (&all_list);
 
   /* Set up a thread structure for the running thread. */
@@ -104,6 +191,7 @@ thread_init (void)
   init_thread (initial_thread, "main", PRI_DEFAULT);
   initial_thread->status = THREAD_RUNNING;
   initial_thread->tid = allocate_tid ();
+  last_tsc = rdtsc ();
 }
 
 /* Starts preemptive thread scheduling by enabling interrupts.
@@ -116,6 +204,10 @@ thread_start (void)
   sema_init (&idle_started, 0);
   thread_create ("idle", PRI_MIN, idle, &idle_started);
 
+  /* The initial thread started out before -mlfqs was parsed. */
+  if (thread_mlfqs)
+    mlfqs_update_priority (initial_thread);
+
   /* Start preemptive thread scheduling. */
   intr_enable ();
 
@@ -140,17 +232,147 @@ thread_tick (void)
   else
     kernel_ticks++;
 
+  if (t->edf || edf_enabled)
+    edf_tick (t);
+  if (thread_mlfqs)
+    mlfqs_tick (t);
+  else if (thread_stride && t != idle_thread && !t->edf)
+    t->pass += STRIDE1 / t->shares;
+
   /* Enforce preemption. */
-  if (++thread_ticks >= TIME_SLICE)
+  if (++thread_ticks >= thread_time_slice)
+    intr_yield_on_return ();
+}
+
+/* MLFQS bookkeeping for timer tick, with T running.  The cost is
+   bounded by the threads that ran lately, except once a second,
+   when every thread's recent_cpu decays. */
+static void
+mlfqs_tick (struct thread *t)
+{
+  int64_t now = timer_ticks ();
+
+  if (t != idle_thread)
+    {
+      t->recent_cpu = fix_add (t->recent_cpu, fix_int (1));
+      if (!t->charged)
+        {
+          t->charged = true;
+          list_push_back (&charged_list, &t->charged_elem);
+        }
+    }
+
+  if (now % TIMER_FREQ == 0)
+    {
+      int ready = ready_cnt + (t != idle_thread);
+
+      load_avg = fix_add (fix_mul (fix_frac (59, 60), load_avg),
+                          fix_frac (ready, 60));
+      thread_foreach (mlfqs_decay, NULL);
+    }
+  if (now % MLFQS_PRIORITY_TICKS == 0)
+    while (!list_empty (&charged_list))
+      {
+        struct thread *c = list_entry (list_pop_front (&charged_list),
+                                       struct thread, charged_elem);
+        c->charged = false;
+        mlfqs_update_priority (c);
+      }
+
+  if (ready_outranks (t))
     intr_yield_on_return ();
 }
 
+/* Decays T's recent_cpu, as done once a second, and updates its
+   priority to match. */
+static void
+mlfqs_decay (struct thread *t, void *aux UNUSED)
+{
+  fixed_point_t twice_load = fix_scale (load_avg, 2);
+
+  if (t == idle_thread)
+    return;
+  t->recent_cpu = fix_add (fix_mul (fix_div (twice_load,
+                                             fix_add (twice_load, fix_int (1))),
+                                    t->recent_cpu),
+                           fix_int (t->nice));
+  mlfqs_update_priority (t);
+}
+
+/* Sets T's priority from its recent_cpu and nice, moving T to
+   its new run queue if it is ready. */
+static void
+mlfqs_update_priority (struct thread *t)
+{
+  int priority = PRI_MAX - fix_trunc (fix_unscale (t->recent_cpu, 4))
+                 - t->nice * 2;
+
+  if (priority < PRI_MIN)
+    priority = PRI_MIN;
+  else if (priority > PRI_MAX)
+    priority = PRI_MAX;
+
+  if (priority == t->priority)
+    return;
+  if (t->status == THREAD_READY && !t->edf)
+    {
+      ready_remove (t);
+      t->priority = t->base_priority = priority;
+      ready_push (t);
+    }
+  else
+    t->priority = t->base_priority = priority;
+}
+
+/* Credits CNT timer ticks, which passed without a timer
+   interrupt while the PIT counted down for tickless idle, to the
+   idle thread. */
+void
+thread_tick_idle (int64_t cnt)
+{
+  idle_ticks += cnt;
+}
+
+/* Charges the TSC cycles since the last call to the running
+   thread, as user time if USER, otherwise as kernel time, or as
+   idle time for the idle thread.  Called on every thread switch,
+   on entry to the kernel from user mode (with USER true), and on
+   return to user mode (with USER false). */
+void
+thread_charge_cycles (bool user)
+{
+  struct thread *t = running_thread ();
+  enum intr_level old_level = intr_disable ();
+  uint64_t now = rdtsc ();
+  uint64_t cycles = now - last_tsc;
+
+  last_tsc = now;
+  if (user)
+    {
+      t->user_cycles += cycles;
+      user_cycles += cycles;
+    }
+  else if (t == idle_thread)
+    idle_cycles += cycles;
+  else
+    {
+      t->kernel_cycles += cycles;
+      kernel_cycles += cycles;
+    }
+  intr_set_level (old_level);
+}
+
 /* Prints thread statistics. */
 void
 thread_print_stats (void)
 {
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
+  printf ("Thread: %"PRIu64" idle cycles, %"PRIu64" kernel cycles, "
+          "%"PRIu64" user cycles\n", idle_cycles, kernel_cycles, user_cycles);
+  if (edf_enabled)
+    printf ("EDF: %lld deadline misses, %lld budget overruns\n",
+            edf_miss_cnt, edf_overrun_cnt);
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -165,18 +387,17 @@ thread_print_stats (void)
    scheduled.  Use a semaphore or some other form of
    synchronization if you need to ensure ordering.
 
-   The code provided sets the new thread's `priority' member to
-   PRIORITY, but no actual priority scheduling is implemented.
-   Priority scheduling is the goal of Problem 1-3. */
-
-struct thread *
-thread_create_get_thread (const char *name, int priority,
+   If the new thread's PRIORITY is higher than the running
+   thread's, the new thread runs before thread_create() returns. */
+tid_t
+thread_create (const char *name, int priority,
                thread_func *function, void *aux)
 {
   struct thread *t;
   struct kernel_thread_frame *kf;
   struct switch_entry_frame *ef;
   struct switch_threads_frame *sf;
+  enum intr_level old_level;
   tid_t tid;
 
   ASSERT (function != NULL);
@@ -184,17 +405,37 @@ thread_create_get_thread (const char *name, int priority,
   /* Allocate thread. */
   t = palloc_get_page (PAL_ZERO);
   if (t == NULL)
-    return NULL;
+    return TID_ERROR;
 
-  /* Initialize thread. */
+  /* Initialize thread, unless the pass heap could not hold it.
+     Interrupts stay off from the check until the thread is
+     counted, so that two creators cannot both take the last
+     slot. */
+  old_level = intr_disable ();
+  if (thread_stride && thread_cnt >= STRIDE_HEAP_MAX)
+    {
+      intr_set_level (old_level);
+      palloc_free_page (t);
+      return TID_ERROR;
+    }
   init_thread (t, name, priority);
+  intr_set_level (old_level);
   tid = t->tid = allocate_tid ();
 
+  /* Under MLFQS, the priority argument is ignored: the new
+     thread's priority follows from what it inherits.  The idle
+     thread keeps PRI_MIN. */
+  if (thread_mlfqs && function != idle)
+    {
+      t->nice = thread_current ()->nice;
+      t->recent_cpu = thread_current ()->recent_cpu;
+      mlfqs_update_priority (t);
+    }
+
+#ifdef USERPROG
   /* Our garbages */
   list_init(&(t->file_descriptors));
-  sema_init(&(t->waiter), 0);
-  sema_init(&(t->loader), 0);
-  t->success = 0;
+#endif
 
   /* Stack frame for kernel_thread(). */
   kf = alloc_frame (t, sizeof *kf);
@@ -213,39 +454,9 @@ thread_create_get_thread (const char *name, int priority,
 
   /* Add to run queue. */
   thread_unblock (t);
+  thread_preempt ();
 
-  return t;
-}
-
-tid_t
-thread_create (const char *name, int priority,
-               thread_func *function, void *aux)
-{
-  struct thread *t = thread_create_get_thread(name, priority, function, aux);
-  if(t == NULL)
-    return TID_ERROR;
-  else
-    return t->tid;
-}
-
-/* Our garbage
-   This function get thread from tid
-*/
-struct thread *
-get_thread_from_tid(tid_t tid)
-{
-  struct list_elem *e;
-
-  ASSERT (intr_get_level () == INTR_OFF);
-
-  for (e = list_begin (&all_list); e != list_end (&all_list);
-       e = list_next (e))
-    {
-      struct thread *t = list_entry (e, struct thread, allelem);
-      if (t->tid == tid) return t;
-    }
-
-  return NULL;
+  return tid;
 }
 
 /* Puts the current thread to sleep.  It will not be scheduled
@@ -271,7 +482,10 @@ thread_block (void)
    This function does not preempt the running thread.  This can
    be important: if the caller had disabled interrupts itself,
    it may expect that it can atomically unblock a thread and
-   update other data. */
+   update other data.  Callers that can give up the CPU should
+   call thread_preempt() once done.  In an interrupt handler,
+   though, unblocking a thread of higher priority than the
+   running thread makes the handler yield on return. */
 void
 thread_unblock (struct thread *t)
 {
@@ -281,11 +495,33 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  list_push_back (&ready_list, &t->elem);
+  ready_push (t);
   t->status = THREAD_READY;
+  if (intr_context () && ready_outranks (thread_current ()))
+    intr_yield_on_return ();
   intr_set_level (old_level);
 }
 
+/* Yields the CPU if a ready thread outranks the running thread:
+   an EDF thread with an earlier deadline, or, if the running
+   thread is not EDF, a thread of higher priority.  From an
+   interrupt handler, the yield happens when the handler returns.
+   With interrupts turned off outside one, the caller presumably
+   wants to stay atomic, so the yield waits for the next time
+   slice. */
+void
+thread_preempt (void)
+{
+  if (intr_context ())
+    {
+      if (ready_outranks (thread_current ()))
+        intr_yield_on_return ();
+    }
+  else if (intr_get_level () == INTR_ON
+           && ready_outranks (thread_current ()))
+    thread_yield ();
+}
+
 /* Returns the name of the running thread. */
 const char *
 thread_name (void)
@@ -326,16 +562,26 @@ thread_exit (void)
 {
   ASSERT (!intr_context ());
   
+#ifdef FILESYS
   dir_close(thread_current ()->cwd);
+#endif
 
 #ifdef USERPROG
   process_exit ();
 #endif
 
+  malloc_thread_exit ();
+
   /* Remove thread from all threads list, set our status to dying,
      and schedule another process.  That process will destroy us
      when it calls thread_schedule_tail(). */
   intr_disable ();
+  list_remove (&thread_current ()->allelem);
+  thread_cnt--;
+  if (thread_current ()->charged)
+    list_remove (&thread_current ()->charged_elem);
+  if (thread_current ()->edf)
+    edf_util -= thread_current ()->edf_util;
   thread_current ()->status = THREAD_DYING;
   schedule ();
   NOT_REACHED ();
@@ -353,7 +599,7 @@ thread_yield (void)
 
   old_level = intr_disable ();
   if (cur != idle_thread)
-    list_push_back (&ready_list, &cur->elem);
+    ready_push (cur);
   cur->status = THREAD_READY;
   schedule ();
   intr_set_level (old_level);
@@ -376,11 +622,85 @@ thread_foreach (thread_action_func *func, void *aux)
     }
 }
 
-/* Sets the current thread's priority to NEW_PRIORITY. */
+/* Sets the current thread's base priority to NEW_PRIORITY,
+   yielding if that leaves a ready thread of higher priority.
+   Priority donated to the thread still applies on top.  Does
+   nothing under MLFQS, which sets priorities itself. */
 void
 thread_set_priority (int new_priority)
 {
-  thread_current ()->priority = new_priority;
+  enum intr_level old_level;
+
+  ASSERT (PRI_MIN <= new_priority && new_priority <= PRI_MAX);
+
+  if (thread_mlfqs)
+    return;
+
+  old_level = intr_disable ();
+  thread_current ()->base_priority = new_priority;
+  thread_refresh_priority ();
+  intr_set_level (old_level);
+  thread_preempt ();
+}
+
+/* Raises T's priority to PRIORITY, if that is higher, moving T
+   to its new run queue if it is ready.  Used to donate priority
+   to the holder of a lock.  Interrupts must be off. */
+void
+thread_raise_priority (struct thread *t, int priority)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (is_thread (t));
+
+  if (priority <= t->priority)
+    return;
+  if (t->status == THREAD_READY && !t->edf)
+    {
+      ready_remove (t);
+      t->priority = priority;
+      ready_push (t);
+    }
+  else
+    t->priority = priority;
+}
+
+/* Recomputes the running thread's priority as the higher of its
+   base priority and the highest priority of any thread waiting
+   for a lock that it holds.  Interrupts must be off. */
+void
+thread_refresh_priority (void)
+{
+  struct thread *cur = thread_current ();
+  struct list_elem *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  cur->priority = cur->base_priority;
+  for (e = list_begin (&cur->locks_held); e != list_end (&cur->locks_held);
+       e = list_next (e))
+    {
+      struct list *waiters = &list_entry (e, struct lock, elem)->semaphore.waiters;
+      if (!list_empty (waiters))
+        {
+          struct thread *t = list_entry (list_max (waiters,
+                                                   thread_priority_less,
+                                                   NULL),
+                                         struct thread, elem);
+          if (t->priority > cur->priority)
+            cur->priority = t->priority;
+        }
+    }
+}
+
+/* Orders threads, given by their `elem' members, by priority. */
+bool
+thread_priority_less (const struct list_elem *a_,
+                      const struct list_elem *b_, void *aux UNUSED)
+{
+  const struct thread *a = list_entry (a_, struct thread, elem);
+  const struct thread *b = list_entry (b_, struct thread, elem);
+
+  return a->priority < b->priority;
 }
 
 /* Returns the current thread's priority. */
@@ -390,35 +710,238 @@ thread_get_priority (void)
   return thread_current ()->priority;
 }
 
-/* Sets the current thread's nice value to NICE. */
+/* Makes the current thread an EDF thread that needs BUDGET ticks
+   of CPU in each PERIOD ticks, within DEADLINE ticks of the start
+   of the period, with its first period starting now.  Returns
+   false, changing nothing, if the parameters are inconsistent or
+   if admitting the thread would reserve more than EDF_UTIL_MAX of
+   the CPU for EDF threads.  A PERIOD of 0 makes the thread an
+   ordinary one again. */
+bool
+thread_set_edf (int64_t period, int64_t budget, int64_t deadline)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  int util;
+
+  if (period == 0)
+    {
+      old_level = intr_disable ();
+      if (cur->edf)
+        edf_util -= cur->edf_util;
+      cur->edf = false;
+      intr_set_level (old_level);
+      return true;
+    }
+  if (budget < 1 || budget > deadline || deadline > period)
+    return false;
+
+  /* Round up, to err on the side of rejecting. */
+  util = (budget * 1000 + period - 1) / period;
+
+  old_level = intr_disable ();
+  if (edf_util - (cur->edf ? cur->edf_util : 0) + util > EDF_UTIL_MAX)
+    {
+      intr_set_level (old_level);
+      return false;
+    }
+  edf_util += util - (cur->edf ? cur->edf_util : 0);
+  edf_enabled = true;
+  cur->edf = true;
+  cur->edf_period = period;
+  cur->edf_budget = budget;
+  cur->edf_rel_deadline = deadline;
+  cur->edf_util = util;
+  cur->edf_next_release = timer_ticks ();
+  edf_new_job (cur, cur->edf_next_release);
+  intr_set_level (old_level);
+  thread_preempt ();
+  return true;
+}
+
+/* Stores the number of the current thread's EDF jobs that missed
+   their deadlines in *MISSES, and of those that ran out of
+   budget in *OVERRUNS. */
+void
+thread_get_edf_stats (int *misses, int *overruns)
+{
+  *misses = thread_current ()->edf_misses;
+  *overruns = thread_current ()->edf_overruns;
+}
+
+/* EDF bookkeeping for a timer tick, with T running: releases the
+   throttled threads whose next job is due, counts missed
+   deadlines against ready jobs that are still waiting, starts
+   T's next job if its period is over, charges T for the tick,
+   and counts a missed deadline or an overrun budget against
+   T's job. */
+static void
+edf_tick (struct thread *t)
+{
+  int64_t now = timer_ticks ();
+  struct list_elem *e;
+
+  while (!list_empty (&edf_throttled))
+    {
+      struct thread *r = list_entry (list_front (&edf_throttled),
+                                     struct thread, elem);
+      if (r->edf_next_release > now)
+        break;
+      list_pop_front (&edf_throttled);
+      edf_new_job (r, now);
+      list_insert_ordered (&edf_ready, &r->elem, edf_deadline_less, NULL);
+      ready_cnt++;
+    }
+
+  /* edf_ready is in deadline order, so the jobs that have just
+     missed their deadlines waiting for the CPU are at its
+     front. */
+  for (e = list_begin (&edf_ready); e != list_end (&edf_ready);
+       e = list_next (e))
+    {
+      struct thread *r = list_entry (e, struct thread, elem);
+      if (r->edf_deadline >= now)
+        break;
+      edf_check_miss (r, now);
+    }
+
+  if (t->edf)
+    {
+      /* T wanted the CPU all along, so if its job's deadline
+         passed, the job missed it. */
+      edf_check_miss (t, now);
+      if (now >= t->edf_next_release)
+        edf_new_job (t, now);
+      t->edf_used++;
+      edf_check_miss (t, now);
+      if (t->edf_used > t->edf_budget && !t->edf_throttled)
+        {
+          t->edf_throttled = true;
+          t->edf_overruns++;
+          edf_overrun_cnt++;
+          intr_yield_on_return ();
+        }
+    }
+
+  if (ready_outranks (t))
+    intr_yield_on_return ();
+}
+
+/* Counts a missed deadline against EDF thread T's current job if
+   its deadline is before NOW and the miss was not yet counted. */
+static void
+edf_check_miss (struct thread *t, int64_t now)
+{
+  if (!t->edf_missed && now > t->edf_deadline)
+    {
+      t->edf_missed = true;
+      t->edf_misses++;
+      edf_miss_cnt++;
+    }
+}
+
+/* Starts EDF thread T's job for the period that NOW falls in,
+   skipping any periods that passed while T was not ready. */
+static void
+edf_new_job (struct thread *t, int64_t now)
+{
+  int64_t release = t->edf_next_release;
+
+  if (now > release)
+    release += (now - release) / t->edf_period * t->edf_period;
+  t->edf_deadline = release + t->edf_rel_deadline;
+  t->edf_next_release = release + t->edf_period;
+  t->edf_used = 0;
+  t->edf_missed = false;
+  t->edf_throttled = false;
+}
+
+/* Orders EDF threads by the deadline of their current job. */
+static bool
+edf_deadline_less (const struct list_elem *a_, const struct list_elem *b_,
+                   void *aux UNUSED)
+{
+  const struct thread *a = list_entry (a_, struct thread, elem);
+  const struct thread *b = list_entry (b_, struct thread, elem);
+
+  return a->edf_deadline < b->edf_deadline;
+}
+
+/* Orders EDF threads by the release of their next job. */
+static bool
+edf_release_less (const struct list_elem *a_, const struct list_elem *b_,
+                  void *aux UNUSED)
+{
+  const struct thread *a = list_entry (a_, struct thread, elem);
+  const struct thread *b = list_entry (b_, struct thread, elem);
+
+  return a->edf_next_release < b->edf_next_release;
+}
+
+/* Sets the current thread's share of the CPU under the stride
+   scheduler to SHARES.  Returns false, changing nothing, if
+   SHARES is out of range. */
+bool
+thread_set_shares (int shares)
+{
+  if (shares < SHARES_MIN || shares > SHARES_MAX)
+    return false;
+  thread_current ()->shares = shares;
+  return true;
+}
+
+/* Returns the current thread's share of the CPU. */
+int
+thread_get_shares (void)
+{
+  return thread_current ()->shares;
+}
+
+/* Sets the current thread's nice value to NICE, recomputing its
+   priority and yielding if it no longer has the highest. */
 void
-thread_set_nice (int nice UNUSED)
+thread_set_nice (int nice)
 {
-  /* Not yet implemented. */
+  enum intr_level old_level;
+
+  if (nice < NICE_MIN)
+    nice = NICE_MIN;
+  else if (nice > NICE_MAX)
+    nice = NICE_MAX;
+
+  old_level = intr_disable ();
+  thread_current ()->nice = nice;
+  if (thread_mlfqs)
+    mlfqs_update_priority (thread_current ());
+  intr_set_level (old_level);
+  thread_preempt ();
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void)
 {
-  /* Not yet implemented. */
-  return 0;
+  return thread_current ()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void)
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int load = fix_round (fix_scale (load_avg, 100));
+  intr_set_level (old_level);
+  return load;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu (void)
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int recent = fix_round (fix_scale (thread_current ()->recent_cpu, 100));
+  intr_set_level (old_level);
+  return recent;
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -443,6 +966,26 @@ idle (void *idle_started_ UNUSED)
       intr_disable ();
       thread_block ();
 
+      /* Nothing else wants the CPU, so zero some free pages for
+         later PAL_ZERO requests.  Interrupts are on meanwhile, so
+         that any thread woken up preempts us. */
+      intr_enable ();
+      while (palloc_prezero ())
+        continue;
+      intr_disable ();
+
+      /* A thread readied meanwhile does not always preempt us: it
+         may have priority PRI_MIN, like us, or run under the
+         stride scheduler.  Run it rather than halting. */
+      if (ready_cnt > 0)
+        continue;
+
+      /* Stop the periodic timer interrupt until the next tick at
+         which something is due, unless EDF threads are waiting
+         for their next jobs, which timer ticks release. */
+      if (list_empty (&edf_throttled))
+        timer_idle_enter ();
+
       /* Re-enable interrupts and wait for the next one.
 
          The `sti' instruction disables interrupts until the
@@ -506,11 +1049,17 @@ init_thread (struct thread *t, const char *name, int priority)
   t->status = THREAD_BLOCKED;
   strlcpy (t->name, name, sizeof t->name);
   t->stack = (uint8_t *) t + PGSIZE;
-  t->priority = priority;
+  t->priority = t->base_priority = priority;
+  t->shares = SHARES_DEFAULT;
+  list_init (&t->locks_held);
+#ifdef VM
+  list_init (&t->mappings);
+#endif
   t->magic = THREAD_MAGIC;
 
   old_level = intr_disable ();
   list_push_back (&all_list, &t->allelem);
+  thread_cnt++;
   intr_set_level (old_level);
 }
 
@@ -535,10 +1084,169 @@ alloc_frame (struct thread *t, size_t size)
 static struct thread *
 next_thread_to_run (void)
 {
-  if (list_empty (&ready_list))
+  int priority = ready_max_priority ();
+  struct list *queue;
+  struct thread *t;
+
+  if (!list_empty (&edf_ready))
+    {
+      ready_cnt--;
+      return list_entry (list_pop_front (&edf_ready), struct thread, elem);
+    }
+
+  if (thread_stride)
+    {
+      if (pass_heap_cnt == 0)
+        return idle_thread;
+      ready_cnt--;
+      t = pass_heap_pop ();
+      stride_pass = t->pass;
+      return t;
+    }
+
+  if (priority < PRI_MIN)
     return idle_thread;
+
+  queue = &ready_queues[priority - PRI_MIN];
+  t = list_entry (list_pop_front (queue), struct thread, elem);
+  ready_cnt--;
+  if (list_empty (queue))
+    ready_bitmap &= ~((uint64_t) 1 << (priority - PRI_MIN));
+  return t;
+}
+
+/* Adds T to the back of the ready queue for its priority, or to
+   the pass heap under the stride scheduler.  An EDF thread goes
+   on edf_ready instead, starting a new job if its period is
+   over, unless it is out of budget until its next job. */
+static void
+ready_push (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t->edf)
+    {
+      int64_t now = timer_ticks ();
+
+      if (now >= t->edf_next_release)
+        edf_new_job (t, now);
+      if (t->edf_throttled)
+        {
+          list_insert_ordered (&edf_throttled, &t->elem,
+                               edf_release_less, NULL);
+          return;
+        }
+      list_insert_ordered (&edf_ready, &t->elem, edf_deadline_less, NULL);
+    }
+  else if (thread_stride)
+    {
+      if (t->pass < stride_pass)
+        t->pass = stride_pass;
+      pass_heap_push (t);
+    }
   else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+    {
+      list_push_back (&ready_queues[t->priority - PRI_MIN], &t->elem);
+      ready_bitmap |= (uint64_t) 1 << (t->priority - PRI_MIN);
+    }
+  ready_cnt++;
+}
+
+/* Returns true if a ready thread should run instead of CUR: an
+   EDF thread with an earlier deadline than CUR's, if CUR is EDF,
+   otherwise any EDF thread or a thread of higher priority. */
+static bool
+ready_outranks (struct thread *cur)
+{
+  if (!list_empty (&edf_ready))
+    {
+      struct thread *t = list_entry (list_front (&edf_ready),
+                                     struct thread, elem);
+      if (!cur->edf || t->edf_deadline < cur->edf_deadline)
+        return true;
+    }
+  return !cur->edf && ready_max_priority () > cur->priority;
+}
+
+/* Removes ready thread T from its run queue. */
+static void
+ready_remove (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->status == THREAD_READY);
+  ASSERT (!thread_stride && !t->edf);
+
+  list_remove (&t->elem);
+  ready_cnt--;
+  if (list_empty (&ready_queues[t->priority - PRI_MIN]))
+    ready_bitmap &= ~((uint64_t) 1 << (t->priority - PRI_MIN));
+}
+
+/* Adds T to the pass heap. */
+static void
+pass_heap_push (struct thread *t)
+{
+  int i = pass_heap_cnt++;
+
+  ASSERT (i < STRIDE_HEAP_MAX);
+
+  /* Sift up. */
+  while (i > 0 && pass_heap[(i - 1) / 2]->pass > t->pass)
+    {
+      pass_heap[i] = pass_heap[(i - 1) / 2];
+      i = (i - 1) / 2;
+    }
+  pass_heap[i] = t;
+}
+
+/* Removes and returns the thread with the lowest pass from the
+   pass heap, which must not be empty. */
+static struct thread *
+pass_heap_pop (void)
+{
+  struct thread *min = pass_heap[0];
+  struct thread *last;
+  int i = 0;
+
+  ASSERT (pass_heap_cnt > 0);
+
+  last = pass_heap[--pass_heap_cnt];
+  for (;;)
+    {
+      int child = 2 * i + 1;
+      if (child >= pass_heap_cnt)
+        break;
+      if (child + 1 < pass_heap_cnt
+          && pass_heap[child + 1]->pass < pass_heap[child]->pass)
+        child++;
+      if (pass_heap[child]->pass >= last->pass)
+        break;
+      pass_heap[i] = pass_heap[child];
+      i = child;
+    }
+  pass_heap[i] = last;
+  return min;
+}
+
+/* Returns the highest priority of any ready thread, or
+   PRI_MIN - 1 if no thread is ready.  BSR scans a 32-bit word,
+   so the bitmap takes at most two. */
+static int
+ready_max_priority (void)
+{
+  uint32_t word = ready_bitmap >> 32;
+  uint32_t bit;
+  int base = 32;
+
+  if (word == 0)
+    {
+      word = ready_bitmap;
+      base = 0;
+      if (word == 0)
+        return PRI_MIN - 1;
+    }
+  asm ("bsrl %1, %0" : "=r" (bit) : "rm" (word));
+  return PRI_MIN + base + bit;
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -583,10 +1291,7 @@ thread_schedule_tail (struct thread *prev)
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread)
     {
       ASSERT (prev != cur);
-      // This is kesafat kari
-      // If you remove thread, you lost exit_code
-      // So sorry memory :(
-      // palloc_free_page (prev);
+      palloc_free_page (prev);
     }
 }
 
@@ -608,8 +1313,13 @@ schedule (void)
   ASSERT (cur->status != THREAD_RUNNING);
   ASSERT (is_thread (next));
 
+  if (cur == idle_thread)
+    timer_idle_exit ();
   if (cur != next)
-    prev = switch_threads (cur, next);
+    {
+      thread_charge_cycles (false);
+      prev = switch_threads (cur, next);
+    }
   thread_schedule_tail (prev);
 }
 
@@ -631,6 +1341,33 @@ allocate_tid (void)
    Used by switch.S, which can't figure it out on its own. */
 uint32_t thread_stack_ofs = offsetof (struct thread, stack);
 
+#ifdef FILESYS
+/* Cache for struct file_descriptor. */
+static struct kmem_cache *fd_cache;
+
+/* Creates the cache that file descriptors come from.  Must be
+   called after malloc_init() and before the first open. */
+void
+file_descriptor_init (void)
+{
+  fd_cache = kmem_cache_create ("fd", sizeof (struct file_descriptor), NULL);
+}
+
+/* Returns a new, uninitialized file descriptor, or a null
+   pointer if memory is not available. */
+struct file_descriptor *
+alloc_file_descriptor (void)
+{
+  return kmem_cache_alloc (fd_cache);
+}
+
+/* Frees FD, which must come from alloc_file_descriptor(). */
+void
+free_file_descriptor (struct file_descriptor *fd)
+{
+  kmem_cache_free (fd_cache, fd);
+}
+
 struct file_descriptor *
 get_file_descriptor_from_fd (struct list *l, int the_fd)
 {
@@ -665,7 +1402,7 @@ get_dir_from_fd (struct list *l, int the_fd)
 struct file_descriptor*
 create_file_descriptor_from_file (struct list *l, struct file* file)
 {
-  struct file_descriptor *fds = malloc(sizeof (struct file_descriptor));
+  struct file_descriptor *fds = alloc_file_descriptor ();
   fds->fd = fdall;
   fdall += 1;
   fds->file = file;
@@ -676,7 +1413,7 @@ create_file_descriptor_from_file (struct list *l, struct file* file)
 struct file_descriptor*
 create_file_descriptor_from_dir (struct list *l, struct dir* dir)
 {
-  struct file_descriptor *fds = malloc(sizeof (struct file_descriptor));
+  struct file_descriptor *fds = alloc_file_descriptor ();
   fds->fd = fdall;
   fdall += 1;
   fds->file = NULL;
@@ -695,6 +1432,7 @@ remove_file_descriptor (struct list *l, int the_fd)
   }
   file_close (file_descriptor_instance->file);
   list_remove (&(file_descriptor_instance->elem));
-  free(file_descriptor_instance);
+  free_file_descriptor (file_descriptor_instance);
   return true;
-}
\ No newline at end of file
+}
+#endif /* FILESYS */
@@ -2,10 +2,13 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <hash.h>
 #include <list.h>
 #include <stdint.h>
 #include "threads/synch.h"
 #include "threads/fixed-point.h"
+#include "threads/malloc.h"
+#include "devices/block.h"
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -90,7 +93,9 @@ struct file_descriptor {
    semaphore wait list (synch.c).  It can be used these two ways
    only because they are mutually exclusive: only a thread in the
    ready state is on the run queue, whereas only a thread in the
-   blocked state is on a semaphore wait list. */
+   blocked state is on a semaphore wait list.  A thread asleep in
+   timer_sleep() is blocked but on no semaphore, so the timer's
+   sleep list uses `elem' too. */
 struct thread
   {
     /* Owned by thread.c. */
@@ -98,22 +103,75 @@ struct thread
     enum thread_status status;          /* Thread state. */
     char name[16];                      /* Name (for debugging purposes). */
     uint8_t *stack;                     /* Saved stack pointer. */
-    int priority;                       /* Priority. */
+    int priority;                       /* Priority, with donations. */
+    int base_priority;                  /* Priority, without donations. */
     struct list_elem allelem;           /* List element for all threads list. */
 
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
+    struct list locks_held;             /* Locks held, for donation. */
+    struct lock *waiting_lock;          /* Lock being waited for, if any. */
+
+    /* Owned by thread.c, for the MLFQS scheduler. */
+    int nice;                           /* Niceness. */
+    fixed_point_t recent_cpu;           /* Recent CPU time, in ticks. */
+    bool charged;                       /* In charged_list? */
+    struct list_elem charged_elem;      /* Element in charged_list. */
+
+    /* Owned by thread.c, for the stride scheduler. */
+    int shares;                         /* Share of the CPU. */
+    uint64_t pass;                      /* Virtual time; lowest runs next. */
+
+    /* Owned by thread.c, for the EDF class.  Times in ticks. */
+    bool edf;                           /* Earliest-deadline-first thread? */
+    int64_t edf_period;                 /* A job is released each period. */
+    int64_t edf_budget;                 /* CPU each job may use. */
+    int64_t edf_rel_deadline;           /* Deadline, from job release. */
+    int edf_util;                       /* Budget / period, in 1/1000s. */
+    int64_t edf_deadline;               /* Current job's deadline. */
+    int64_t edf_next_release;           /* Next job's release. */
+    int64_t edf_used;                   /* CPU used by current job. */
+    bool edf_missed;                    /* Current job missed deadline? */
+    bool edf_throttled;                 /* Out of budget until release? */
+    int edf_misses;                     /* Jobs that missed deadlines. */
+    int edf_overruns;                   /* Jobs that ran out of budget. */
+
+    /* Owned by devices/timer.c. */
+    int64_t wakeup_tick;                /* Tick to wake up at, if asleep. */
+
+    /* Owned by threads/malloc.c. */
+    struct malloc_magazine magazines[MALLOC_CLASS_CNT];
+
+    /* Owned by thread.c. */
+    uint64_t user_cycles;               /* TSC cycles run in user mode. */
+    uint64_t kernel_cycles;             /* TSC cycles run in kernel mode. */
 
    struct dir *cwd;
+    int journal_depth;                  /* Nesting depth of journal handles. */
+    size_t journal_credits;             /* Sectors our handle may still log. */
+    enum block_cause io_cause;          /* What our block I/O is for. */
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     struct file *execfile;
     uint32_t *pagedir;                  /* Page directory. */
     struct list file_descriptors;
-    struct semaphore waiter;
     int exit_code;
-    struct semaphore loader;
-    int success;                        /* Has load been successfull? */
+    struct hash children;               /* Exit statuses of children, by tid. */
+    struct child_status *child_status;  /* Our exit status, or null. */
+#endif
+#ifdef VM
+    /* Owned by vm/page.c. */
+    struct hash pages;                  /* Supplemental page table. */
+
+    void *user_esp;                     /* User ESP in a system call. */
+
+    /* Owned by vm/heap.c. */
+    uint8_t *heap_start;                /* Start of heap. */
+    uint8_t *brk;                       /* End of heap, the "break". */
+
+    /* Owned by vm/mmap.c. */
+    struct list mappings;               /* Memory-mapped files. */
+    int next_mapid;                     /* Next mapping identifier. */
 #endif
 
     /* Owned by thread.c. */
@@ -125,18 +183,39 @@ struct thread
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* If true, use the stride (proportional-share) scheduler, which
+   ignores priorities and divides the CPU among ready threads in
+   proportion to their shares.  Controlled by "-stride". */
+extern bool thread_stride;
+
+/* Stride scheduler shares. */
+#define SHARES_MIN 1                    /* Smallest share. */
+#define SHARES_DEFAULT 100              /* Share of a new thread. */
+#define SHARES_MAX 10000                /* Largest share. */
+
+/* Number of timer ticks each thread gets to run before yielding
+   to others of equal priority.  Set with "-slice". */
+#define TIME_SLICE_DEFAULT 4
+extern int thread_time_slice;
+
 void thread_init (void);
 void thread_start (void);
 
 void thread_tick (void);
+void thread_tick_idle (int64_t cnt);
+void thread_charge_cycles (bool user);
 void thread_print_stats (void);
 
 typedef void thread_func (void *aux);
-struct thread *thread_create_get_thread (const char *name, int priority, thread_func *, void *);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
 
 void thread_block (void);
 void thread_unblock (struct thread *);
+void thread_preempt (void);
+void thread_raise_priority (struct thread *, int priority);
+void thread_refresh_priority (void);
+bool thread_priority_less (const struct list_elem *,
+                           const struct list_elem *, void *aux);
 
 struct thread *thread_current (void);
 tid_t thread_tid (void);
@@ -152,12 +231,24 @@ void thread_foreach (thread_action_func *, void *);
 int thread_get_priority (void);
 void thread_set_priority (int);
 
+/* Most CPU that EDF threads together may reserve, in 1/1000s. */
+#define EDF_UTIL_MAX 900
+
+bool thread_set_edf (int64_t period, int64_t budget, int64_t deadline);
+void thread_get_edf_stats (int *misses, int *overruns);
+
+bool thread_set_shares (int);
+int thread_get_shares (void);
+
 int thread_get_nice (void);
 void thread_set_nice (int);
 int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
 
 
+void file_descriptor_init (void);
+struct file_descriptor *alloc_file_descriptor (void);
+void free_file_descriptor (struct file_descriptor *);
 struct file_descriptor *get_file_descriptor_from_fd (struct list *l, int the_fd);
 struct file *get_file_from_fd (struct list *l, int the_fd);
 struct dir *get_dir_from_fd (struct list *l, int the_fd);
@@ -165,7 +256,4 @@ struct file_descriptor* create_file_descriptor_from_file (struct list *l, struct
 struct file_descriptor* create_file_descriptor_from_dir (struct list *l, struct dir* dir);
 bool remove_file_descriptor (struct list *l, int the_fd);
 
-/* Our garbage */
-struct thread *get_thread_from_tid(tid_t tid);
-
 #endif /* threads/thread.h */
@@ -5,6 +5,10 @@
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "userprog/syscall.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -149,9 +153,22 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
-  /* To implement virtual memory, delete the rest of the function
-     body, and replace it with code that brings in the page to
-     which fault_addr refers. */
+#ifdef VM
+  /* A page of the process that is not in memory yet, touched by
+     the process or by a system call on its behalf: bring it in
+     and retry the access.  The page may be a new stack page; in
+     a system call, F->esp is a kernel stack pointer, so check
+     against the process's stack pointer at entry instead. */
+  if (not_present && is_user_vaddr (fault_addr))
+    {
+      const void *esp = user ? f->esp : thread_current ()->user_esp;
+
+      page_grow_stack (fault_addr, esp);
+      if (page_load (fault_addr))
+        return;
+    }
+#endif
+
   printf ("Page fault at %p: %s error %s page in %s context.\n",
           fault_addr,
           not_present ? "not present" : "rights violation",
@@ -20,12 +20,26 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "threads/malloc.h"
+#ifdef VM
+#include "vm/heap.h"
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 
 static struct semaphore temporary;
 static thread_func start_process NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
+static struct hash *children_table (void);
+static void release_child_status (struct child_status *);
 bool put_main_arguments_in_stack(void **esp, int argc, char *argv[]);
 
+/* What process_execute() passes to start_process(). */
+struct process_start
+  {
+    char *cmd_line;                     /* Page holding the command line. */
+    struct child_status *status;        /* The new process's exit status. */
+  };
+
 /* Starts a new thread running a user program loaded from
    FILENAME.  The new thread may be scheduled (and may even exit)
    before process_execute() returns.  Returns the new process's
@@ -36,7 +50,9 @@ process_execute (const char *file_name)
   char *fn_copy;
   char *dummy_save_ptr;
   tid_t tid;
-  struct thread *t;
+  struct child_status *cs;
+  struct process_start ps;
+  struct hash *children;
 
   sema_init (&temporary, 0);
   /* Make a copy of FILE_NAME.
@@ -63,20 +79,43 @@ process_execute (const char *file_name)
     }
   file_close (file);
 
-  /* Create a new thread to execute FILE_NAME. */
-  t = thread_create_get_thread (actual_file_name, PRI_DEFAULT, start_process, fn_copy);
-  if (t != NULL)
+  children = children_table ();
+  cs = malloc (sizeof *cs);
+  if (children == NULL || cs == NULL)
     {
-      sema_down(&t->loader);
-      if (!(t->success))
-        tid = TID_ERROR;
+      free (cs);
+      palloc_free_page (fn_copy);
+      palloc_free_page (actual_file_name);
+      return TID_ERROR;
+    }
+  cs->exit_code = -1;
+  cs->ref_cnt = 2;
+  sema_init (&cs->exited, 0);
+  cs->loaded = false;
+  sema_init (&cs->load_done, 0);
+
+  /* Create a new thread to execute FILE_NAME.  PS lives on our
+     stack, which is fine because we wait for the child to finish
+     loading before returning. */
+  ps.cmd_line = fn_copy;
+  ps.status = cs;
+  tid = thread_create (actual_file_name, PRI_DEFAULT, start_process, &ps);
+  if (tid != TID_ERROR)
+    {
+      sema_down (&cs->load_done);
+      cs->tid = tid;
+      if (cs->loaded)
+        hash_insert (children, &cs->elem);
       else
-        tid = t->tid;
+        {
+          release_child_status (cs);
+          tid = TID_ERROR;
+        }
     }
   else
     {
       palloc_free_page (fn_copy);
-      tid = TID_ERROR;
+      free (cs);
     }
   palloc_free_page (actual_file_name);
 
@@ -86,12 +125,16 @@ process_execute (const char *file_name)
 /* A thread function that loads a user process and starts it
    running. */
 static void
-start_process (void *file_name_)
+start_process (void *ps_)
 {
-  char *file_name = file_name_;
+  struct process_start *ps = ps_;
+  char *file_name = ps->cmd_line;
+  struct child_status *cs = ps->status;
   struct intr_frame if_;
   bool success;
 
+  thread_current ()->child_status = cs;
+
   /* Initialize interrupt frame and load executable. */
   memset (&if_, 0, sizeof if_);
   if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
@@ -101,9 +144,8 @@ start_process (void *file_name_)
 
   /* If load failed, quit. */
   palloc_free_page (file_name);
-  struct thread *t = thread_current ();
-  t->success = success;
-  sema_up(&t->loader);
+  cs->loaded = success;
+  sema_up (&cs->load_done);
   if (!success)
     _exit(-1);
 
@@ -113,6 +155,7 @@ start_process (void *file_name_)
      arguments on the stack in the form of a `struct intr_frame',
      we just point the stack pointer (%esp) to our stack frame
      and jump to it. */
+  thread_charge_cycles (false);
   asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
   NOT_REACHED ();
 }
@@ -124,28 +167,85 @@ start_process (void *file_name_)
    been successfully called for the given TID, returns -1
    immediately, without waiting.
 
-   This function will be implemented in problem 2-2.  For now, it
-   does nothing. */
+   The child's exit status is kept in its struct child_status,
+   found in our children by TID and removed from them once waited
+   for, so a second wait for the same TID finds nothing. */
 int
 process_wait (tid_t child_tid)
 {
-  enum intr_level old_level = intr_disable ();
-  struct thread *child = get_thread_from_tid(child_tid);
+  struct hash *children = children_table ();
+  struct child_status key, *cs;
+  struct hash_elem *e;
+  int status;
+
+  if (children == NULL)
+    return -1;
+  key.tid = child_tid;
+  e = hash_delete (children, &key.elem);
+  if (e == NULL)
+    return -1;
+
+  cs = hash_entry (e, struct child_status, elem);
+  sema_down (&cs->exited);
+  status = cs->exit_code;
+  release_child_status (cs);
+  return status;
+}
+
+/* Returns a hash value for child_status CS_. */
+static unsigned
+child_hash (const struct hash_elem *cs_, void *aux UNUSED)
+{
+  const struct child_status *cs = hash_entry (cs_, struct child_status, elem);
+  return hash_int (cs->tid);
+}
+
+/* Returns true if child_status A_ precedes child_status B_. */
+static bool
+child_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct child_status *a = hash_entry (a_, struct child_status, elem);
+  const struct child_status *b = hash_entry (b_, struct child_status, elem);
+  return a->tid < b->tid;
+}
+
+/* Returns the running thread's children, keyed by tid, or a null
+   pointer if memory is not available.  The table is set up on
+   first use, because the initial thread also runs user programs
+   and thread_init() sets it up before malloc() works. */
+static struct hash *
+children_table (void)
+{
+  struct thread *t = thread_current ();
+
+  if (t->children.buckets == NULL
+      && !hash_init (&t->children, child_hash, child_less, NULL))
+    return NULL;
+  return &t->children;
+}
+
+/* Drops the parent's reference to child_status CS_, for
+   hash_destroy(). */
+static void
+release_child_elem (struct hash_elem *cs_, void *aux UNUSED)
+{
+  release_child_status (hash_entry (cs_, struct child_status, elem));
+}
+
+/* Drops a reference to CS, freeing it if it was the last. */
+static void
+release_child_status (struct child_status *cs)
+{
+  enum intr_level old_level;
+  bool last;
+
+  old_level = intr_disable ();
+  last = --cs->ref_cnt == 0;
   intr_set_level (old_level);
-  if (child == NULL)
-    {
-      return -1;
-    }
-  else
-    {
-      sema_down (&(child->waiter));
-      int status = child->exit_code;
-      old_level = intr_disable ();
-      list_remove (&(child->allelem));
-      palloc_free_page(child);
-      intr_set_level (old_level);
-      return status;
-    }
+
+  if (last)
+    free (cs);
 }
 
 
@@ -160,7 +260,7 @@ free_file_descriptor_pages (struct thread *t)
       struct file_descriptor, elem);
       e = list_remove (&(ev->elem));
       file_close(ev->file);
-      free(ev);
+      free_file_descriptor (ev);
     }
 }
 
@@ -171,6 +271,13 @@ process_exit (void)
   struct thread *cur = thread_current ();
   uint32_t *pd;
 
+#ifdef VM
+  /* Free our pages and their frames while our page directory
+     and executable are still around, writing back mapped files
+     first. */
+  mmap_unmap_all ();
+  page_table_destroy (&cur->pages);
+#endif
   file_close (cur->execfile);
   free_file_descriptor_pages(cur);
 
@@ -190,7 +297,17 @@ process_exit (void)
       pagedir_activate (NULL);
       pagedir_destroy (pd);
     }
-  sema_up (&(cur->waiter));
+
+  /* Publish our exit status to our parent, and give up our
+     children's, which nobody can wait for any more. */
+  if (cur->child_status != NULL)
+    {
+      cur->child_status->exit_code = cur->exit_code;
+      sema_up (&cur->child_status->exited);
+      release_child_status (cur->child_status);
+      cur->child_status = NULL;
+    }
+  hash_destroy (&cur->children, release_child_elem);
 }
 
 /* Sets up the CPU for running user code in the current
@@ -294,11 +411,18 @@ load (const char *_file_name, void (**eip) (void), void **esp)
   off_t file_ofs;
   bool success = false;
   int i;
+#ifdef VM
+  uint8_t *heap_start = NULL;
+#endif
 
   /* Allocate and activate page directory. */
   t->pagedir = pagedir_create ();
   if (t->pagedir == NULL)
     goto done;
+#ifdef VM
+  if (!page_table_init (&t->pages))
+    goto done;
+#endif
 
   char **argv = palloc_get_page(0);
   int argc;
@@ -383,6 +507,10 @@ load (const char *_file_name, void (**eip) (void), void **esp)
               if (!load_segment (file, file_page, (void *) mem_page,
                                  read_bytes, zero_bytes, writable))
                 goto done;
+#ifdef VM
+              if (mem_page + read_bytes + zero_bytes > (uint32_t) heap_start)
+                heap_start = (uint8_t *) mem_page + read_bytes + zero_bytes;
+#endif
             }
           else
             goto done;
@@ -390,6 +518,11 @@ load (const char *_file_name, void (**eip) (void), void **esp)
         }
     }
 
+#ifdef VM
+  /* The heap starts out empty, after the last segment. */
+  heap_init (heap_start);
+#endif
+
   /* Set up stack. */
   if (!setup_stack (esp))
     goto done;
@@ -415,7 +548,9 @@ load (const char *_file_name, void (**eip) (void), void **esp)
 
 /* load() helpers. */
 
+#ifndef VM
 static bool install_page (void *upage, void *kpage, bool writable);
+#endif
 
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
@@ -474,6 +609,9 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
    The pages initialized by this function must be writable by the
    user process if WRITABLE is true, read-only otherwise.
 
+   With virtual memory, the pages are only entered in the
+   supplemental page table here, and read in when first touched.
+
    Return true if successful, false if a memory allocation error
    or disk read error occurs. */
 static bool
@@ -493,6 +631,11 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
+#ifdef VM
+      if (!page_add_file (upage, file, ofs, page_read_bytes, writable))
+        return false;
+      ofs += page_read_bytes;
+#else
       /* Get a page of memory. */
       uint8_t *kpage = palloc_get_page (PAL_USER);
       if (kpage == NULL)
@@ -512,6 +655,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
           palloc_free_page (kpage);
           return false;
         }
+#endif
 
       /* Advance. */
       read_bytes -= page_read_bytes;
@@ -526,6 +670,14 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 static bool
 setup_stack (void **esp)
 {
+#ifdef VM
+  uint8_t *upage = ((uint8_t *) PHYS_BASE) - PGSIZE;
+
+  if (!page_add_zero (upage, true) || !page_load (upage))
+    return false;
+  *esp = PHYS_BASE;
+  return true;
+#else
   uint8_t *kpage;
   bool success = false;
 
@@ -539,8 +691,10 @@ setup_stack (void **esp)
         palloc_free_page (kpage);
     }
   return success;
+#endif
 }
 
+#ifndef VM
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
@@ -560,6 +714,7 @@ install_page (void *upage, void *kpage, bool writable)
   return (pagedir_get_page (t->pagedir, upage) == NULL
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
+#endif
 
 bool
 put_main_arguments_in_stack (void **esp, int argc, char *argv[])
@@ -1,8 +1,25 @@
 #ifndef USERPROG_PROCESS_H
 #define USERPROG_PROCESS_H
 
+#include <hash.h>
+#include "threads/synch.h"
 #include "threads/thread.h"
 
+/* The exit status of a child process, shared by the child and
+   its parent.  The child's struct thread is freed as soon as it
+   exits; this small record outlives it until the parent has
+   waited for it or exited too, whichever frees it last. */
+struct child_status
+  {
+    tid_t tid;                          /* Child's thread identifier. */
+    int exit_code;                      /* Status passed to exit(). */
+    int ref_cnt;                        /* Parent and child references. */
+    struct semaphore exited;            /* Up'd when the child exits. */
+    bool loaded;                        /* Did the child load? */
+    struct semaphore load_done;         /* Up'd when load finishes. */
+    struct hash_elem elem;              /* Element in parent's children. */
+  };
+
 tid_t process_execute (const char *file_name);
 int process_wait (tid_t);
 void process_exit (void);
@@ -9,6 +9,11 @@
 #include "filesys/inode.h"
 #include "threads/vaddr.h"
 #include "devices/shutdown.h"
+#ifdef VM
+#include "vm/heap.h"
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 
 #define put_error_on_frame_when_false(o, f) if (!(o)) f->eax=-1
 #define return_on_false(o) if (!(o)) return
@@ -19,13 +24,20 @@
 static void syscall_handler (struct intr_frame *);
 
 bool are_args_valid (uint32_t *, int);
+bool is_pointer_valid (struct thread *, uint32_t *);
 
 bool is_string_valid (char *);
 
+#ifdef VM
+static bool pin_buffer (const void *, size_t, bool write);
+static void unpin_buffer (const void *, size_t);
+#endif
+
 void
 syscall_init (void)
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
+  file_descriptor_init ();
 }
 
 void _exit (int status)
@@ -41,6 +53,10 @@ syscall_handler (struct intr_frame *f UNUSED)
 {
   uint32_t *args = ((uint32_t *) f->esp);
 
+#ifdef VM
+  thread_current ()->user_esp = f->esp;
+#endif
+
   /*
    * The following print statement, if uncommented, will print out the syscall
    * number whenever a process enters a system call. You might find it useful
@@ -90,7 +106,7 @@ syscall_handler (struct intr_frame *f UNUSED)
           struct dir *d = dir_open (inode);
           put_error_on_frame_when_null (d, f);
           return_on_null (d);
-          fds = malloc(sizeof (struct file_descriptor));
+          fds = alloc_file_descriptor ();
           fds->fd = fdall;
           fdall += 1;
           fds->dir = d;
@@ -101,7 +117,7 @@ syscall_handler (struct intr_frame *f UNUSED)
           struct file *fi = file_open (inode);
           put_error_on_frame_when_null (fi, f);
           return_on_null (fi);
-          fds = malloc(sizeof (struct file_descriptor));
+          fds = alloc_file_descriptor ();
           fds->fd = fdall;
           fdall += 1;
           fds->file = fi;
@@ -133,7 +149,14 @@ syscall_handler (struct intr_frame *f UNUSED)
           struct file *fi = get_file_from_fd (&thread_current ()->file_descriptors, args[1]);
           put_error_on_frame_when_null(fi, f);
           return_on_null(fi);
+#ifdef VM
+          if (!pin_buffer ((void *) args[2], args[3], false))
+            _exit (-1);
+#endif
           f->eax = file_write (fi, args[2], args[3]);
+#ifdef VM
+          unpin_buffer ((void *) args[2], args[3]);
+#endif
         }
     }
   else if (args[0] == SYS_PRACTICE)
@@ -149,7 +172,14 @@ syscall_handler (struct intr_frame *f UNUSED)
       struct file *fi = get_file_from_fd (&thread_current ()->file_descriptors, args[1]);
       put_error_on_frame_when_null(fi, f);
       return_on_null(fi);
+#ifdef VM
+      if (!pin_buffer ((void *) args[2], args[3], true))
+        _exit (-1);
+#endif
       f->eax = file_read (fi, args[2], args[3]);
+#ifdef VM
+      unpin_buffer ((void *) args[2], args[3]);
+#endif
     }
   else if (args[0] == SYS_CREATE)
     {
@@ -171,7 +201,7 @@ syscall_handler (struct intr_frame *f UNUSED)
       return_on_null(file_descriptor_instance);
       file_close (file_descriptor_instance->file);
       list_remove (&(file_descriptor_instance->elem));
-      free(file_descriptor_instance);
+      free_file_descriptor (file_descriptor_instance);
     }
   else if (args[0] == SYS_SEEK)
     {
@@ -277,20 +307,150 @@ syscall_handler (struct intr_frame *f UNUSED)
         _exit (-1);
       f->eax = block_read_write_counts(fs_device, (long long*) args[1], (long long*) args[2]);
     }
+  else if (args[0] == SYS_FSYNC || args[0] == SYS_FDATASYNC)
+    {
+      if (!are_args_valid (args, 2))
+        _exit (-1);
+      struct file_descriptor *fds = get_file_descriptor_from_fd (&thread_current ()->file_descriptors, args[1]);
+      put_error_on_frame_when_null (fds, f);
+      return_on_null (fds);
+      struct inode *inode = fds->file != NULL ? file_get_inode (fds->file) : dir_get_inode (fds->dir);
+      inode_sync (inode, args[0] == SYS_FDATASYNC);
+      f->eax = true;
+    }
+  else if (args[0] == SYS_BLOCKTRACE)
+    block_trace_dump ();
+  else if (args[0] == SYS_SETSHARES)
+    {
+      if (!are_args_valid (args, 2))
+        _exit (-1);
+      f->eax = thread_set_shares (args[1]);
+    }
+#ifdef VM
+  else if (args[0] == SYS_MMAP)
+    {
+      if (!are_args_valid (args, 3))
+        _exit (-1);
+      struct file *fi = get_file_from_fd (&thread_current ()->file_descriptors, args[1]);
+      f->eax = fi != NULL ? mmap_map (fi, (void *) args[2]) : MAP_FAILED;
+    }
+  else if (args[0] == SYS_MUNMAP)
+    {
+      if (!are_args_valid (args, 2))
+        _exit (-1);
+      mmap_unmap (args[1]);
+    }
+  else if (args[0] == SYS_SBRK)
+    {
+      if (!are_args_valid (args, 2))
+        _exit (-1);
+      f->eax = (uint32_t) heap_sbrk ((intptr_t) args[1]);
+    }
+#endif
+  else if (args[0] == SYS_EDF)
+    {
+      if (!are_args_valid (args, 3))
+        _exit (-1);
+      f->eax = thread_set_edf ((int) args[1], (int) args[2], (int) args[3]);
+    }
+  else if (args[0] == SYS_EDFSTAT)
+    {
+      if (!are_args_valid (args, 2)
+          || !is_pointer_valid (thread_current (), (uint32_t *) args[1])
+          || !is_pointer_valid (thread_current (), (uint32_t *) args[2]))
+        _exit (-1);
+      thread_get_edf_stats ((int *) args[1], (int *) args[2]);
+    }
 }
 
+/* With virtual memory, a page that is part of the process's
+   address space need not be in memory: it is brought in when
+   the kernel touches it.  Nor need a stack page exist yet: the
+   stack grows when the kernel touches it. */
 bool
 is_pointer_mapped (struct thread *t, uint32_t *p)
 {
+#ifdef VM
+  if (page_lookup (p) != NULL || page_is_stack (p, t->user_esp))
+    return true;
+#endif
   return pagedir_get_page (t->pagedir, p) != NULL;
 }
 
 bool
 is_void_pointer_mapped (struct thread *t, uint32_t *p)
 {
+#ifdef VM
+  if (page_lookup (p) != NULL || page_is_stack (p, t->user_esp))
+    return true;
+#endif
   return pagedir_get_page (t->pagedir, p) != NULL;
 }
 
+#ifdef VM
+/* Returns true if all SIZE bytes at BUFFER lie below PHYS_BASE.
+   Checking that BUFFER + SIZE does not pass PHYS_BASE is not
+   enough, because the sum may wrap around to a low address. */
+static bool
+is_buffer_in_user_space (const void *buffer, size_t size)
+{
+  return is_user_vaddr (buffer)
+         && size <= (uintptr_t) PHYS_BASE - (uintptr_t) buffer;
+}
+
+/* Brings in and pins the pages of the SIZE bytes at user address
+   BUFFER, so that a file read or write into them does not fault
+   while holding file system locks.  Grows the stack if BUFFER is
+   on it.  If WRITE, the pages must be writable.  Returns false,
+   with nothing pinned, if some page is not part of the address
+   space. */
+static bool
+pin_buffer (const void *buffer, size_t size, bool write)
+{
+  const void *esp = thread_current ()->user_esp;
+  const uint8_t *start = pg_round_down (buffer);
+  const uint8_t *end = (const uint8_t *) buffer + size;
+  const uint8_t *p;
+
+  if (!is_buffer_in_user_space (buffer, size))
+    return false;
+
+  for (p = start; p < end; p += PGSIZE)
+    {
+      const void *addr = p == start ? buffer : p;
+
+      if (!is_user_vaddr (addr))
+        break;
+      page_grow_stack (addr, esp);
+      if (!page_pin (addr, write))
+        break;
+    }
+  if (p >= end)
+    return true;
+
+  while (p > start)
+    {
+      p -= PGSIZE;
+      page_unpin (p);
+    }
+  return false;
+}
+
+/* Unpins the pages pinned by pin_buffer (BUFFER, SIZE, ...). */
+static void
+unpin_buffer (const void *buffer, size_t size)
+{
+  const uint8_t *end = (const uint8_t *) buffer + size;
+  const uint8_t *p;
+
+  if (!is_buffer_in_user_space (buffer, size))
+    return;
+
+  for (p = pg_round_down (buffer); p < end; p += PGSIZE)
+    page_unpin (p);
+}
+#endif
+
 bool
 is_pointer_valid (struct thread *t, uint32_t *p)
 {
@@ -0,0 +1,347 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include <string.h>
+#include "threads/palloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
+#include "vm/share.h"
+
+/* The frame table: every user pool frame that holds a user page.
+
+   A frame is handed out pinned, so that it cannot be taken away
+   while its page is being read in, and is unpinned by its owner
+   once the page is mapped.
+
+   Most frames hold a page of a single process.  A frame that
+   holds a shared text page (see vm/share.c) is instead mapped by
+   every process that has touched the page since it was read in,
+   and its PAGES list has all of their pages.  It is freed when
+   the last of them leaves it.
+
+   When the user pool runs out, a frame is taken from another
+   page by the clock algorithm: a hand sweeps the table, giving
+   each unpinned frame whose page was accessed since the last
+   sweep a second chance, and evicting the first one that was
+   not.  Eviction happens with FRAME_LOCK held throughout, so a
+   page's frame is never seen half evicted.
+
+   The exception is a dirty page of a memory-mapped file, whose
+   write-back does file system I/O that must not stall every page
+   fault in the system.  Such a frame is instead pinned and marked
+   "cleaning", and written back with FRAME_LOCK released while it
+   stays mapped; a later sweep may then evict it if it is still
+   clean.  Freeing a frame waits for any write-back to finish. */
+static struct list frames;
+
+/* Next frame to examine, or the end of FRAMES. */
+static struct list_elem *clock_hand;
+
+/* Protects FRAMES, CLOCK_HAND, the members of its frames, the
+   binding between frames and pages, and the FRAME member of
+   shared pages. */
+static struct lock frame_lock;
+
+/* Signaled when a frame's write-back finishes. */
+static struct condition cleaning_done;
+
+/* Cache for struct frame. */
+static struct kmem_cache *frame_cache;
+
+static struct frame *evict (void);
+
+/* Initializes the frame table. */
+void
+frame_init (void)
+{
+  list_init (&frames);
+  clock_hand = list_end (&frames);
+  lock_init (&frame_lock);
+  cond_init (&cleaning_done);
+  frame_cache = kmem_cache_create ("frame", sizeof (struct frame), NULL);
+}
+
+/* Obtains a frame, zeroed if ZERO is true, and returns it
+   pinned, for frame_map() to give to a page.  Evicts another
+   page if the user pool is empty.  Returns a null pointer if no
+   page can be evicted. */
+struct frame *
+frame_alloc (bool zero)
+{
+  struct frame *f;
+  void *kpage;
+
+  kpage = palloc_get_page (PAL_USER | (zero ? PAL_ZERO : 0));
+  if (kpage != NULL)
+    {
+      f = kmem_cache_alloc (frame_cache);
+      if (f == NULL)
+        {
+          palloc_free_page (kpage);
+          return NULL;
+        }
+      f->kpage = kpage;
+      list_init (&f->pages);
+      f->share = NULL;
+      f->pin_cnt = 1;
+      f->cleaning = false;
+      lock_acquire (&frame_lock);
+      list_push_back (&frames, &f->elem);
+      lock_release (&frame_lock);
+      return f;
+    }
+
+  lock_acquire (&frame_lock);
+  f = evict ();
+  if (f != NULL)
+    f->pin_cnt = 1;
+  lock_release (&frame_lock);
+  if (f != NULL && zero)
+    memset (f->kpage, 0, PGSIZE);
+  return f;
+}
+
+/* Removes F from the frame table.  FRAME_LOCK must be held. */
+static void
+remove_frame (struct frame *f)
+{
+  if (clock_hand == &f->elem)
+    clock_hand = list_next (clock_hand);
+  list_remove (&f->elem);
+}
+
+/* Removes F, which must not have been mapped yet, from the frame
+   table and frees it and its page. */
+void
+frame_free (struct frame *f)
+{
+  ASSERT (list_empty (&f->pages));
+
+  lock_acquire (&frame_lock);
+  remove_frame (f);
+  lock_release (&frame_lock);
+
+  palloc_free_page (f->kpage);
+  kmem_cache_free (frame_cache, f);
+}
+
+/* Maps PAGE to frame F, which must be pinned, in its process's
+   page directory.  If PAGE is a shared text page, F becomes the
+   frame that other processes touching it will map too.  Returns
+   false if memory for the page directory is not available. */
+bool
+frame_map (struct page *page, struct frame *f)
+{
+  bool ok;
+
+  ASSERT (f->pin_cnt > 0);
+
+  lock_acquire (&frame_lock);
+  ok = pagedir_set_page (page->thread->pagedir, page->upage, f->kpage,
+                         page->writable);
+  if (ok)
+    {
+      list_push_back (&f->pages, &page->frame_elem);
+      page->frame = f;
+      if (page->share != NULL)
+        {
+          f->share = page->share;
+          f->share->frame = f;
+        }
+    }
+  lock_release (&frame_lock);
+  return ok;
+}
+
+/* If the shared text page of PAGE is already in a frame, maps
+   PAGE to it, pins it, and returns true.  Otherwise returns
+   false. */
+bool
+frame_map_shared (struct page *page)
+{
+  struct frame *f;
+  bool ok = false;
+
+  ASSERT (page->share != NULL);
+
+  lock_acquire (&frame_lock);
+  f = page->share->frame;
+  if (f != NULL
+      && pagedir_set_page (page->thread->pagedir, page->upage, f->kpage,
+                           false))
+    {
+      list_push_back (&f->pages, &page->frame_elem);
+      page->frame = f;
+      f->pin_cnt++;
+      ok = true;
+    }
+  lock_release (&frame_lock);
+  return ok;
+}
+
+/* Unmaps PAGE and takes it out of its frame, if it has one.  The
+   frame is freed unless other processes still map it. */
+void
+frame_release (struct page *page)
+{
+  struct frame *f;
+  bool last = false;
+
+  lock_acquire (&frame_lock);
+  while (page->frame != NULL && page->frame->cleaning)
+    cond_wait (&cleaning_done, &frame_lock);
+  f = page->frame;
+  if (f != NULL)
+    {
+      pagedir_clear_page (page->thread->pagedir, page->upage);
+      list_remove (&page->frame_elem);
+      page->frame = NULL;
+      if (list_empty (&f->pages))
+        {
+          last = true;
+          if (f->share != NULL)
+            f->share->frame = NULL;
+          remove_frame (f);
+        }
+    }
+  lock_release (&frame_lock);
+
+  if (last)
+    {
+      palloc_free_page (f->kpage);
+      kmem_cache_free (frame_cache, f);
+    }
+}
+
+/* Pins PAGE's frame, keeping it from being evicted, and returns
+   true, if PAGE has a frame.  Otherwise returns false. */
+bool
+frame_pin (struct page *page)
+{
+  bool pinned = false;
+
+  lock_acquire (&frame_lock);
+  if (page->frame != NULL)
+    {
+      page->frame->pin_cnt++;
+      pinned = true;
+    }
+  lock_release (&frame_lock);
+  return pinned;
+}
+
+/* Undoes one pinning of F. */
+void
+frame_unpin (struct frame *f)
+{
+  lock_acquire (&frame_lock);
+  ASSERT (f->pin_cnt > 0);
+  f->pin_cnt--;
+  lock_release (&frame_lock);
+}
+
+/* Returns the frame under the clock hand and advances the hand,
+   wrapping around at the end of the table. */
+static struct frame *
+clock_next (void)
+{
+  struct frame *f;
+
+  if (clock_hand == list_end (&frames))
+    clock_hand = list_begin (&frames);
+  f = list_entry (clock_hand, struct frame, elem);
+  clock_hand = list_next (clock_hand);
+  return f;
+}
+
+/* Returns true if any page mapped to F was accessed since the
+   last call, and clears their accessed bits. */
+static bool
+was_accessed (struct frame *f)
+{
+  struct list_elem *e;
+  bool accessed = false;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      uint32_t *pd = p->thread->pagedir;
+
+      if (pagedir_is_accessed (pd, p->upage))
+        {
+          pagedir_set_accessed (pd, p->upage, false);
+          accessed = true;
+        }
+    }
+  return accessed;
+}
+
+/* Writes back PAGE, the dirty PAGE_MMAP page in frame F, with
+   FRAME_LOCK released.  FRAME_LOCK must be held on entry, and is
+   held again on return. */
+static void
+clean_frame (struct frame *f, struct page *page)
+{
+  f->pin_cnt++;
+  f->cleaning = true;
+  lock_release (&frame_lock);
+
+  page_write_back (page);
+
+  lock_acquire (&frame_lock);
+  f->cleaning = false;
+  f->pin_cnt--;
+  cond_broadcast (&cleaning_done, &frame_lock);
+}
+
+/* Chooses a frame by the clock algorithm, evicts its pages, and
+   returns it, still in the frame table.  Returns a null pointer
+   if every frame is pinned or no page can be written out.
+   FRAME_LOCK must be held. */
+static struct frame *
+evict (void)
+{
+  size_t i, cnt;
+
+  /* Two sweeps: the first may only clear accessed bits. */
+  cnt = 2 * list_size (&frames);
+  for (i = 0; i < cnt; i++)
+    {
+      struct frame *f = clock_next ();
+      struct page *first;
+
+      if (f->pin_cnt > 0 || was_accessed (f))
+        continue;
+
+      /* A shared page is clean and read-only, so only a private
+         page can fail to be evicted, and it is alone. */
+      first = list_entry (list_front (&f->pages), struct page, frame_elem);
+      if (first->kind == PAGE_MMAP
+          && pagedir_is_dirty (first->thread->pagedir, first->upage))
+        {
+          clean_frame (f, first);
+          continue;
+        }
+      if (!page_evict (first))
+        continue;
+      while (!list_empty (&f->pages))
+        {
+          struct page *p = list_entry (list_pop_front (&f->pages),
+                                       struct page, frame_elem);
+          if (p != first)
+            page_evict (p);
+          p->frame = NULL;
+        }
+      if (f->share != NULL)
+        {
+          f->share->frame = NULL;
+          f->share = NULL;
+        }
+      return f;
+    }
+  return NULL;
+}
@@ -0,0 +1,31 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <list.h>
+#include <stdbool.h>
+
+struct page;
+struct share;
+
+/* A physical frame from the user pool, holding one user page,
+   or one shared text page mapped by any number of processes. */
+struct frame
+  {
+    void *kpage;                        /* Kernel virtual address. */
+    struct list pages;                  /* Pages mapped to it. */
+    struct share *share;                /* Shared page held, or null. */
+    unsigned pin_cnt;                   /* Evictable only if zero. */
+    bool cleaning;                      /* Being written back? */
+    struct list_elem elem;              /* Element in frame table. */
+  };
+
+void frame_init (void);
+struct frame *frame_alloc (bool zero);
+void frame_free (struct frame *);
+bool frame_map (struct page *, struct frame *);
+bool frame_map_shared (struct page *);
+void frame_release (struct page *);
+bool frame_pin (struct page *);
+void frame_unpin (struct frame *);
+
+#endif /* vm/frame.h */
@@ -0,0 +1,71 @@
+#include "vm/heap.h"
+#include <round.h>
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/page.h"
+
+/* The process heap.
+
+   The heap runs from the end of the executable's last segment to
+   the "break", which sbrk() moves.  The pages it covers are zero
+   pages in the supplemental page table, given frames only when
+   touched; pages it no longer covers are removed at once, so
+   that touching them faults. */
+
+/* Value sbrk() returns on failure. */
+#define SBRK_FAILED ((void *) -1)
+
+/* Starts the running process's heap, empty, at START, the end of
+   its executable's segments. */
+void
+heap_init (void *start)
+{
+  struct thread *t = thread_current ();
+
+  t->heap_start = t->brk = pg_round_up (start);
+}
+
+/* Removes the running process's pages from START up to END. */
+static void
+remove_pages (uint8_t *start, uint8_t *end)
+{
+  for (; start < end; start += PGSIZE)
+    page_remove (start);
+}
+
+/* Moves the running process's break INCREMENT bytes up, or down
+   if INCREMENT is negative, and returns the old break.  Returns
+   SBRK_FAILED, leaving the break alone, if the heap would shrink
+   below its start, run into the stack region or another page, or
+   exceed the commit limit. */
+void *
+heap_sbrk (intptr_t increment)
+{
+  struct thread *t = thread_current ();
+  uint8_t *old_brk = t->brk;
+  uint8_t *old_top = pg_round_up (old_brk);
+  uint8_t *new_brk, *new_top, *p;
+
+  if (increment >= 0)
+    {
+      uint8_t *heap_max = (uint8_t *) PHYS_BASE - page_stack_max;
+      if (old_brk > heap_max
+          || (size_t) increment > (size_t) (heap_max - old_brk))
+        return SBRK_FAILED;
+    }
+  else if (-(size_t) increment > (size_t) (old_brk - t->heap_start))
+    return SBRK_FAILED;
+  new_brk = old_brk + increment;
+  new_top = pg_round_up (new_brk);
+
+  for (p = old_top; p < new_top; p += PGSIZE)
+    if (!page_add_zero (p, true))
+      {
+        remove_pages (old_top, p);
+        return SBRK_FAILED;
+      }
+  remove_pages (new_top, old_top);
+
+  t->brk = new_brk;
+  return old_brk;
+}
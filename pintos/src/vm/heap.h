@@ -0,0 +1,9 @@
+#ifndef VM_HEAP_H
+#define VM_HEAP_H
+
+#include <stdint.h>
+
+void heap_init (void *start);
+void *heap_sbrk (intptr_t increment);
+
+#endif /* vm/heap.h */
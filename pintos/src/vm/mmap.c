@@ -0,0 +1,124 @@
+#include "vm/mmap.h"
+#include <list.h>
+#include <round.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/page.h"
+
+/* A memory-mapped file.
+
+   Each page of the mapping is a PAGE_MMAP page in the process's
+   supplemental page table, read from the file when first touched
+   and written back when it leaves memory dirty.  The mapping
+   holds its own reopened file, so that it survives the process
+   closing the descriptor it was created from. */
+struct mapping
+  {
+    mapid_t mapid;                      /* Identifier. */
+    struct file *file;                  /* Mapped file. */
+    uint8_t *base;                      /* Start of the mapping. */
+    size_t page_cnt;                    /* Number of pages mapped. */
+    struct list_elem elem;              /* Element in thread's mappings. */
+  };
+
+/* Removes the first CNT pages at BASE from the running process. */
+static void
+remove_pages (uint8_t *base, size_t cnt)
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    page_remove (base + i * PGSIZE);
+}
+
+/* Maps FILE into the running process's address space at ADDR,
+   which must be page-aligned, and returns the new mapping's
+   identifier.  Returns MAP_FAILED if FILE is empty or the pages
+   it would occupy are not free user pages. */
+mapid_t
+mmap_map (struct file *file, void *addr)
+{
+  struct thread *t = thread_current ();
+  struct mapping *m;
+  off_t length;
+  size_t i;
+
+  if (addr == NULL || pg_ofs (addr) != 0)
+    return MAP_FAILED;
+  length = file_length (file);
+  if (length == 0)
+    return MAP_FAILED;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return MAP_FAILED;
+  m->file = file_reopen (file);
+  if (m->file == NULL)
+    {
+      free (m);
+      return MAP_FAILED;
+    }
+  m->base = addr;
+  m->page_cnt = DIV_ROUND_UP (length, PGSIZE);
+
+  for (i = 0; i < m->page_cnt; i++)
+    {
+      uint8_t *upage = m->base + i * PGSIZE;
+      off_t ofs = i * PGSIZE;
+      size_t read_bytes = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+
+      if (!is_user_vaddr (upage) || upage < m->base
+          || !page_add_mmap (upage, m->file, ofs, read_bytes))
+        {
+          remove_pages (m->base, i);
+          file_close (m->file);
+          free (m);
+          return MAP_FAILED;
+        }
+    }
+
+  m->mapid = t->next_mapid++;
+  list_push_back (&t->mappings, &m->elem);
+  return m->mapid;
+}
+
+/* Unmaps M, writing back its dirty pages, and frees it. */
+static void
+unmap (struct mapping *m)
+{
+  list_remove (&m->elem);
+  remove_pages (m->base, m->page_cnt);
+  file_close (m->file);
+  free (m);
+}
+
+/* Unmaps the running process's mapping MAPID, if it exists. */
+void
+mmap_unmap (mapid_t mapid)
+{
+  struct list *mappings = &thread_current ()->mappings;
+  struct list_elem *e;
+
+  for (e = list_begin (mappings); e != list_end (mappings);
+       e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      if (m->mapid == mapid)
+        {
+          unmap (m);
+          return;
+        }
+    }
+}
+
+/* Unmaps all of the running process's mappings, on exit. */
+void
+mmap_unmap_all (void)
+{
+  struct list *mappings = &thread_current ()->mappings;
+
+  while (!list_empty (mappings))
+    unmap (list_entry (list_front (mappings), struct mapping, elem));
+}
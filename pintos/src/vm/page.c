@@ -0,0 +1,480 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/palloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/share.h"
+#include "vm/swap.h"
+
+/* Supplemental page table.
+
+   Each process has a hash table of the pages of its address
+   space, keyed by user virtual address.  A page is entered when
+   the process's executable is loaded or its stack is set up,
+   but given a frame only when it is first touched: the page
+   fault handler calls page_load(), which reads the page from
+   its file or zeroes it and maps it.  A process thus uses
+   memory only for the pages it actually touches.
+
+   A page that is evicted from its frame is discarded if it can
+   be brought back from where it came from, that is, if it is
+   clean and still PAGE_ZERO or PAGE_FILE.  Otherwise it is
+   written to swap and becomes PAGE_SWAP for good: once read
+   back, its only copy is in memory, so it is written out again
+   the next time whether dirty or not.
+
+   A PAGE_MMAP page belongs to a memory-mapped file.  It is read
+   from the file like PAGE_FILE, but when dirty it is written
+   back to the file, instead of to swap, whenever it leaves
+   memory: on eviction, munmap, or exit.
+
+   A read-only PAGE_FILE page of an executable refers to a shared
+   page (see vm/share.c), so that all the processes running the
+   executable read it in once and map the same frame.
+
+   The stack starts as a single page just below PHYS_BASE and
+   grows a page at a time when the process touches the page below
+   it, as long as the access is near the stack pointer and the
+   stack stays within PAGE_STACK_MAX bytes.  New stack pages are
+   zero pages, given frames only when touched, like any other.
+
+   Memory is overcommitted in that a process may have far more
+   pages than there are frames, but not beyond what swap can back:
+   a page that might have to be written to swap, that is, any
+   writable page other than PAGE_MMAP, is charged against a
+   commit limit of the user pool plus swap, less COMMIT_RESERVE
+   pages for everything else that needs frames.  Adding a page
+   fails once the limit is reached, so that running out shows up
+   as, say, sbrk() failing, instead of a page fault that cannot
+   be serviced. */
+
+/* Frames kept out of the commit limit, for pages that are not
+   charged against it: text, mapped files, pinned buffers. */
+#define COMMIT_RESERVE 32
+
+/* Limit on user stack size, in bytes. */
+size_t page_stack_max = STACK_MAX_DEFAULT;
+
+/* Pages charged against the commit limit, and the limit. */
+static size_t commit_cnt;
+static size_t commit_limit;
+static struct lock commit_lock;
+
+/* Cache for struct page. */
+static struct kmem_cache *page_cache;
+
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+static bool page_in (struct page *);
+
+/* Initializes the supplemental page table module. */
+void
+page_init (void)
+{
+  size_t backing = palloc_user_page_cnt () + swap_slot_cnt ();
+
+  commit_limit = backing > COMMIT_RESERVE ? backing - COMMIT_RESERVE : 0;
+  lock_init (&commit_lock);
+  page_cache = kmem_cache_create ("page", sizeof (struct page), NULL);
+}
+
+/* Initializes PAGES as an empty supplemental page table.
+   Returns false if memory is not available. */
+bool
+page_table_init (struct hash *pages)
+{
+  return hash_init (pages, page_hash, page_less, NULL);
+}
+
+/* Returns true if page P is charged against the commit limit. */
+static bool
+is_committed (const struct page *p)
+{
+  return p->writable && p->kind != PAGE_MMAP;
+}
+
+/* Charges a page against the commit limit.  Returns false if the
+   limit has been reached. */
+static bool
+commit_page (void)
+{
+  bool ok;
+
+  lock_acquire (&commit_lock);
+  ok = commit_cnt < commit_limit;
+  if (ok)
+    commit_cnt++;
+  lock_release (&commit_lock);
+  return ok;
+}
+
+/* Gives back a page charged by commit_page(). */
+static void
+uncommit_page (void)
+{
+  lock_acquire (&commit_lock);
+  ASSERT (commit_cnt > 0);
+  commit_cnt--;
+  lock_release (&commit_lock);
+}
+
+/* Frees page P_ and its frame, if any. */
+static void
+destroy_page (struct hash_elem *p_, void *aux UNUSED)
+{
+  struct page *p = hash_entry (p_, struct page, elem);
+
+  if (p->kind == PAGE_MMAP && frame_pin (p))
+    page_write_back (p);
+  frame_release (p);
+  if (p->share != NULL)
+    share_put (p->share);
+  if (p->kind == PAGE_SWAP && p->swap_slot != SWAP_ERROR)
+    swap_free (p->swap_slot);
+  if (is_committed (p))
+    uncommit_page ();
+  kmem_cache_free (page_cache, p);
+}
+
+/* Frees every page in PAGES, a supplemental page table of the
+   running thread, and their frames, and PAGES itself. */
+void
+page_table_destroy (struct hash *pages)
+{
+  hash_destroy (pages, destroy_page);
+}
+
+/* Removes the running process's page at UPAGE, writing it back
+   to its file first if it is a dirty PAGE_MMAP page. */
+void
+page_remove (void *upage)
+{
+  struct page *p = page_lookup (upage);
+
+  ASSERT (p != NULL);
+  hash_delete (&thread_current ()->pages, &p->elem);
+  destroy_page (&p->elem, NULL);
+}
+
+/* Returns true if an access to UADDR by a process whose stack
+   pointer is ESP looks like a stack access: within the stack
+   limit, and at or above ESP - 32, because PUSHA checks for room
+   for 32 bytes before moving the stack pointer. */
+bool
+page_is_stack (const void *uaddr, const void *esp)
+{
+  const uint8_t *addr = uaddr;
+
+  return (is_user_vaddr (addr)
+          && addr >= (const uint8_t *) PHYS_BASE - page_stack_max
+          && addr + 32 >= (const uint8_t *) esp);
+}
+
+/* Grows the running process's stack to include UADDR, by adding
+   a zero page, if page_is_stack (UADDR, ESP) and UADDR is not in
+   any page yet.  Returns true if a page was added. */
+bool
+page_grow_stack (const void *uaddr, const void *esp)
+{
+  if (!page_is_stack (uaddr, esp) || page_lookup (uaddr) != NULL)
+    return false;
+  return page_add_zero (pg_round_down (uaddr), true);
+}
+
+/* Returns the running process's page that contains UADDR, or a
+   null pointer if there is none. */
+struct page *
+page_lookup (const void *uaddr)
+{
+  struct page key;
+  struct hash_elem *e;
+
+  key.upage = pg_round_down (uaddr);
+  e = hash_find (&thread_current ()->pages, &key.elem);
+  return e != NULL ? hash_entry (e, struct page, elem) : NULL;
+}
+
+/* Enters a page at UPAGE in the running process's page table,
+   with contents of kind KIND, and returns it.  Returns a null
+   pointer if UPAGE is already in use, memory is not available,
+   or the page would exceed the commit limit. */
+static struct page *
+add_page (void *upage, bool writable, enum page_kind kind)
+{
+  struct thread *t = thread_current ();
+  struct page *p;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+
+  p = kmem_cache_alloc (page_cache);
+  if (p == NULL)
+    return NULL;
+
+  p->upage = upage;
+  p->thread = t;
+  p->writable = writable;
+  p->frame = NULL;
+  p->kind = kind;
+  p->file = NULL;
+  p->file_ofs = 0;
+  p->read_bytes = 0;
+  p->swap_slot = SWAP_ERROR;
+  p->share = NULL;
+  if (is_committed (p) && !commit_page ())
+    {
+      kmem_cache_free (page_cache, p);
+      return NULL;
+    }
+  if (hash_insert (&t->pages, &p->elem) != NULL)
+    {
+      if (is_committed (p))
+        uncommit_page ();
+      kmem_cache_free (page_cache, p);
+      return NULL;
+    }
+  return p;
+}
+
+/* Adds a page of zeros at UPAGE to the running process.
+   Returns false if UPAGE is in use or memory is not available. */
+bool
+page_add_zero (void *upage, bool writable)
+{
+  return add_page (upage, writable, PAGE_ZERO) != NULL;
+}
+
+/* Adds a page at UPAGE to the running process, whose first
+   READ_BYTES bytes are read from FILE at offset OFS and the rest
+   of which is zeros.  If the page is read-only, FILE must be an
+   executable that cannot be written, and the page is shared with
+   other processes running it.  Returns false if UPAGE is in use
+   or memory is not available. */
+bool
+page_add_file (void *upage, struct file *file, off_t ofs,
+               size_t read_bytes, bool writable)
+{
+  struct share *s = NULL;
+  struct page *p;
+
+  ASSERT (read_bytes <= PGSIZE);
+
+  if (!writable && read_bytes > 0)
+    {
+      s = share_get (file, ofs, read_bytes);
+      if (s == NULL)
+        return false;
+    }
+  p = add_page (upage, writable, read_bytes > 0 ? PAGE_FILE : PAGE_ZERO);
+  if (p == NULL)
+    {
+      if (s != NULL)
+        share_put (s);
+      return false;
+    }
+  p->share = s;
+  p->file = file;
+  p->file_ofs = ofs;
+  p->read_bytes = read_bytes;
+  return true;
+}
+
+/* Adds a writable page at UPAGE to the running process that maps
+   READ_BYTES bytes of FILE at offset OFS, followed by zeros.
+   Changes to those bytes are written back to FILE.  Returns
+   false if UPAGE is in use or memory is not available. */
+bool
+page_add_mmap (void *upage, struct file *file, off_t ofs,
+               size_t read_bytes)
+{
+  struct page *p;
+
+  ASSERT (read_bytes > 0 && read_bytes <= PGSIZE);
+
+  p = add_page (upage, true, PAGE_MMAP);
+  if (p == NULL)
+    return false;
+  p->file = file;
+  p->file_ofs = ofs;
+  p->read_bytes = read_bytes;
+  return true;
+}
+
+/* Gives page P a new frame, fills it and maps it, leaving the
+   frame pinned.  Returns false if memory is not available or the
+   page cannot be read. */
+static bool
+fill_frame (struct page *p)
+{
+  struct frame *f;
+
+  f = frame_alloc (p->kind == PAGE_ZERO);
+  if (f == NULL)
+    return false;
+
+  if (p->kind == PAGE_FILE || p->kind == PAGE_MMAP)
+    {
+      if (file_read_at (p->file, f->kpage, p->read_bytes, p->file_ofs)
+          != (off_t) p->read_bytes)
+        {
+          frame_free (f);
+          return false;
+        }
+      memset ((uint8_t *) f->kpage + p->read_bytes, 0,
+              PGSIZE - p->read_bytes);
+    }
+  else if (p->kind == PAGE_SWAP && p->swap_slot != SWAP_ERROR)
+    {
+      swap_in (p->swap_slot, f->kpage);
+      p->swap_slot = SWAP_ERROR;
+    }
+
+  if (!frame_map (p, f))
+    {
+      frame_free (f);
+      return false;
+    }
+  return true;
+}
+
+/* Brings page P into a frame and maps it, leaving the frame
+   pinned.  A shared page is read in only if no other process has
+   it in a frame already.  Returns false if memory is not
+   available or the page cannot be read. */
+static bool
+page_in (struct page *p)
+{
+  bool ok;
+
+  ASSERT (p->frame == NULL);
+
+  if (p->share == NULL)
+    return fill_frame (p);
+
+  lock_acquire (&p->share->lock);
+  ok = frame_map_shared (p) || fill_frame (p);
+  lock_release (&p->share->lock);
+  return ok;
+}
+
+/* Brings in the running process's page that contains UADDR, on
+   a page fault.  Returns false if there is no such page or it
+   cannot be brought in. */
+bool
+page_load (const void *uaddr)
+{
+  struct page *p = page_lookup (uaddr);
+
+  if (p == NULL)
+    return false;
+  if (!frame_pin (p) && !page_in (p))
+    return false;
+  frame_unpin (p->frame);
+  return true;
+}
+
+/* Brings in the running process's page that contains UADDR, if
+   it is not in memory, and pins it there, for the kernel to
+   access during a system call.  If WRITE is true, the page must
+   be writable.  Returns false if there is no such page, it is
+   not writable when it should be, or it cannot be brought in. */
+bool
+page_pin (const void *uaddr, bool write)
+{
+  struct page *p = page_lookup (uaddr);
+
+  if (p == NULL || (write && !p->writable))
+    return false;
+  return frame_pin (p) || page_in (p);
+}
+
+/* Unpins the running process's page that contains UADDR, which
+   must have been pinned by page_pin(). */
+void
+page_unpin (const void *uaddr)
+{
+  struct page *p = page_lookup (uaddr);
+
+  ASSERT (p != NULL && p->frame != NULL);
+  frame_unpin (p->frame);
+}
+
+/* Unmaps page P, which is about to lose its frame, and writes it
+   to swap if its contents cannot otherwise be brought back.
+   Returns false, leaving P mapped, if swap is full or P is a
+   dirty PAGE_MMAP page, which the frame table must first write
+   back with page_write_back().  Called by the frame table with
+   its lock held. */
+bool
+page_evict (struct page *p)
+{
+  uint32_t *pd = p->thread->pagedir;
+
+  /* Unmap first, so that the process cannot dirty the page
+     after we look. */
+  pagedir_clear_page (pd, p->upage);
+  if (p->kind == PAGE_MMAP)
+    {
+      if (pagedir_is_dirty (pd, p->upage))
+        {
+          pagedir_set_page (pd, p->upage, p->frame->kpage, p->writable);
+          pagedir_set_dirty (pd, p->upage, true);
+          return false;
+        }
+    }
+  else if (p->kind == PAGE_SWAP || pagedir_is_dirty (pd, p->upage))
+    {
+      size_t slot = swap_out (p->frame->kpage);
+      if (slot == SWAP_ERROR)
+        {
+          pagedir_set_page (pd, p->upage, p->frame->kpage, p->writable);
+          pagedir_set_dirty (pd, p->upage, true);
+          return false;
+        }
+      p->kind = PAGE_SWAP;
+      p->swap_slot = slot;
+    }
+  return true;
+}
+
+/* Writes PAGE_MMAP page P, whose frame must be pinned, back to
+   its file if it is dirty.  P stays mapped; it is marked clean
+   before it is written, so that a write by the process while
+   the page is being written back makes it dirty again.  Must
+   not be called with the frame table locked, because it does
+   file system I/O. */
+void
+page_write_back (struct page *p)
+{
+  uint32_t *pd = p->thread->pagedir;
+
+  if (pagedir_is_dirty (pd, p->upage))
+    {
+      pagedir_set_dirty (pd, p->upage, false);
+      file_write_at (p->file, p->frame->kpage, p->read_bytes, p->file_ofs);
+    }
+}
+
+/* Returns a hash value for page P_. */
+static unsigned
+page_hash (const struct hash_elem *p_, void *aux UNUSED)
+{
+  const struct page *p = hash_entry (p_, struct page, elem);
+  return hash_bytes (&p->upage, sizeof p->upage);
+}
+
+/* Returns true if page A_ precedes page B_. */
+static bool
+page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED)
+{
+  const struct page *a = hash_entry (a_, struct page, elem);
+  const struct page *b = hash_entry (b_, struct page, elem);
+  return a->upage < b->upage;
+}
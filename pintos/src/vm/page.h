@@ -0,0 +1,64 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+
+/* Where a page's contents come from when it is not in a frame. */
+enum page_kind
+  {
+    PAGE_ZERO,                  /* All zeros. */
+    PAGE_FILE,                  /* Read from a file, then zeros. */
+    PAGE_SWAP,                  /* In swap, or only in memory. */
+    PAGE_MMAP                   /* Mapped file, written back. */
+  };
+
+/* A page of a process's virtual address space, whether or not
+   it is in memory: an entry in the supplemental page table. */
+struct page
+  {
+    void *upage;                        /* User virtual address. */
+    struct thread *thread;              /* Owning process. */
+    struct hash_elem elem;              /* Element in owner's pages. */
+    bool writable;                      /* May the process write it? */
+    struct frame *frame;                /* Frame holding it, or null. */
+    struct list_elem frame_elem;        /* Element in frame's pages. */
+    struct share *share;                /* Shared text page, or null. */
+
+    /* Contents when not in a frame. */
+    enum page_kind kind;
+    struct file *file;                  /* PAGE_FILE, PAGE_MMAP: file. */
+    off_t file_ofs;                     /* Offset in FILE. */
+    size_t read_bytes;                  /* Bytes of FILE in the page. */
+    size_t swap_slot;                   /* PAGE_SWAP: slot, if swapped. */
+  };
+
+/* Limit on user stack size, in bytes.  Set with -stack. */
+#define STACK_MAX_DEFAULT (8 * 1024 * 1024)
+#define STACK_MAX_MB 256
+extern size_t page_stack_max;
+
+void page_init (void);
+bool page_table_init (struct hash *);
+void page_table_destroy (struct hash *);
+
+struct page *page_lookup (const void *uaddr);
+bool page_add_zero (void *upage, bool writable);
+bool page_add_file (void *upage, struct file *, off_t ofs,
+                    size_t read_bytes, bool writable);
+bool page_add_mmap (void *upage, struct file *, off_t ofs,
+                    size_t read_bytes);
+void page_remove (void *upage);
+bool page_is_stack (const void *uaddr, const void *esp);
+bool page_grow_stack (const void *uaddr, const void *esp);
+
+bool page_load (const void *uaddr);
+bool page_pin (const void *uaddr, bool write);
+void page_unpin (const void *uaddr);
+bool page_evict (struct page *);
+void page_write_back (struct page *);
+
+#endif /* vm/page.h */
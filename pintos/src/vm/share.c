@@ -0,0 +1,114 @@
+#include "vm/share.h"
+#include <debug.h>
+#include "filesys/file.h"
+#include "threads/slab.h"
+
+/* Shared text pages.
+
+   A read-only page of an executable is the same in every process
+   that runs it, and the executable cannot change while any of
+   them runs, so one frame can hold it for all of them.  The share
+   table has an entry for each such page, keyed by inode, offset,
+   and the number of bytes read from the file before the page is
+   zero-filled, for as long as some process's page refers to it.  The
+   first process to touch the page reads it in; the others map
+   the same frame (see vm/frame.c). */
+
+/* Share table. */
+static struct hash shares;
+
+/* Protects SHARES and the reference counts of its entries. */
+static struct lock share_lock;
+
+/* Cache for struct share. */
+static struct kmem_cache *share_cache;
+
+static hash_hash_func share_hash;
+static hash_less_func share_less;
+
+/* Initializes the share table. */
+void
+share_init (void)
+{
+  if (!hash_init (&shares, share_hash, share_less, NULL))
+    PANIC ("share: hash table creation failed");
+  lock_init (&share_lock);
+  share_cache = kmem_cache_create ("share", sizeof (struct share), NULL);
+}
+
+/* Returns the shared page whose first READ_BYTES bytes come
+   from offset OFS of FILE, creating it if necessary, with a new
+   reference to it.  Returns a null pointer if memory is not
+   available. */
+struct share *
+share_get (struct file *file, off_t ofs, size_t read_bytes)
+{
+  struct share key, *s;
+  struct hash_elem *e;
+
+  key.inode = file_get_inode (file);
+  key.ofs = ofs;
+  key.read_bytes = read_bytes;
+
+  lock_acquire (&share_lock);
+  e = hash_find (&shares, &key.elem);
+  if (e != NULL)
+    s = hash_entry (e, struct share, elem);
+  else
+    {
+      s = kmem_cache_alloc (share_cache);
+      if (s != NULL)
+        {
+          s->inode = key.inode;
+          s->ofs = ofs;
+          s->read_bytes = read_bytes;
+          s->ref_cnt = 0;
+          lock_init (&s->lock);
+          s->frame = NULL;
+          hash_insert (&shares, &s->elem);
+        }
+    }
+  if (s != NULL)
+    s->ref_cnt++;
+  lock_release (&share_lock);
+  return s;
+}
+
+/* Drops a reference to S, freeing it with the last one.  The
+   page that referred to S must have left S's frame already. */
+void
+share_put (struct share *s)
+{
+  lock_acquire (&share_lock);
+  ASSERT (s->ref_cnt > 0);
+  if (--s->ref_cnt == 0)
+    {
+      hash_delete (&shares, &s->elem);
+      kmem_cache_free (share_cache, s);
+    }
+  lock_release (&share_lock);
+}
+
+/* Returns a hash value for shared page S_. */
+static unsigned
+share_hash (const struct hash_elem *s_, void *aux UNUSED)
+{
+  const struct share *s = hash_entry (s_, struct share, elem);
+  return (hash_bytes (&s->inode, sizeof s->inode) ^ hash_int (s->ofs)
+          ^ hash_int (s->read_bytes));
+}
+
+/* Returns true if shared page A_ precedes shared page B_. */
+static bool
+share_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct share *a = hash_entry (a_, struct share, elem);
+  const struct share *b = hash_entry (b_, struct share, elem);
+
+  if (a->inode != b->inode)
+    return a->inode < b->inode;
+  if (a->ofs != b->ofs)
+    return a->ofs < b->ofs;
+  return a->read_bytes < b->read_bytes;
+}
@@ -0,0 +1,29 @@
+#ifndef VM_SHARE_H
+#define VM_SHARE_H
+
+#include <hash.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "threads/synch.h"
+
+struct file;
+
+/* A read-only page of an executable, shared by every process
+   that runs it. */
+struct share
+  {
+    struct inode *inode;                /* Executable's inode. */
+    off_t ofs;                          /* Offset of the page in it. */
+    size_t read_bytes;                  /* Bytes read; the rest is 0. */
+    int ref_cnt;                        /* Pages referring to it. */
+    struct hash_elem elem;              /* Element in share table. */
+    struct lock lock;                   /* Held while reading it in. */
+    struct frame *frame;                /* Frame holding it, or null.
+                                           Owned by vm/frame.c. */
+  };
+
+void share_init (void);
+struct share *share_get (struct file *, off_t ofs, size_t read_bytes);
+void share_put (struct share *);
+
+#endif /* vm/share.h */
@@ -0,0 +1,94 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdio.h>
+#include "devices/block.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Swap space.
+
+   The swap device is divided into slots of a page each, that is,
+   SECTORS_PER_SLOT consecutive sectors, and a bitmap records
+   which slots are in use.  A page is written or read with a
+   single multi-sector request. */
+
+/* Sectors in a swap slot. */
+#define SECTORS_PER_SLOT (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Swap device, or null if there is none. */
+static struct block *swap_block;
+
+/* Slots in use. */
+static struct bitmap *swap_map;
+
+/* Protects SWAP_MAP. */
+static struct lock swap_lock;
+
+/* Initializes the swap space on the BLOCK_SWAP device.  Without
+   one, pages can still be evicted if they are clean. */
+void
+swap_init (void)
+{
+  size_t slot_cnt = 0;
+
+  lock_init (&swap_lock);
+  swap_block = block_get_role (BLOCK_SWAP);
+  if (swap_block != NULL)
+    slot_cnt = block_size (swap_block) / SECTORS_PER_SLOT;
+  else
+    printf ("swap: no swap device, dirty pages cannot be evicted\n");
+
+  swap_map = bitmap_create (slot_cnt);
+  if (swap_map == NULL)
+    PANIC ("swap: bitmap creation failed");
+}
+
+/* Returns the number of swap slots. */
+size_t
+swap_slot_cnt (void)
+{
+  return bitmap_size (swap_map);
+}
+
+/* Writes the page at KPAGE to a free swap slot and returns the
+   slot, or SWAP_ERROR if swap is full. */
+size_t
+swap_out (const void *kpage)
+{
+  enum block_cause old_cause;
+  size_t slot;
+
+  lock_acquire (&swap_lock);
+  slot = bitmap_scan_and_flip (swap_map, 0, 1, false);
+  lock_release (&swap_lock);
+  if (slot == BITMAP_ERROR)
+    return SWAP_ERROR;
+
+  old_cause = block_set_cause (BLOCK_CAUSE_SWAP);
+  block_write_multiple (swap_block, slot * SECTORS_PER_SLOT,
+                        SECTORS_PER_SLOT, kpage);
+  block_set_cause (old_cause);
+  return slot;
+}
+
+/* Reads SLOT into the page at KPAGE and frees SLOT. */
+void
+swap_in (size_t slot, void *kpage)
+{
+  enum block_cause old_cause = block_set_cause (BLOCK_CAUSE_SWAP);
+  block_read_multiple (swap_block, slot * SECTORS_PER_SLOT,
+                       SECTORS_PER_SLOT, kpage);
+  block_set_cause (old_cause);
+  swap_free (slot);
+}
+
+/* Frees SLOT without reading it. */
+void
+swap_free (size_t slot)
+{
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (swap_map, slot));
+  bitmap_reset (swap_map, slot);
+  lock_release (&swap_lock);
+}
@@ -0,0 +1,16 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include <bitmap.h>
+#include <stddef.h>
+
+/* A swap slot: one page's worth of sectors on the swap device. */
+#define SWAP_ERROR BITMAP_ERROR
+
+void swap_init (void);
+size_t swap_slot_cnt (void);
+size_t swap_out (const void *kpage);
+void swap_in (size_t slot, void *kpage);
+void swap_free (size_t slot);
+
+#endif /* vm/swap.h */